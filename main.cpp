@@ -20,6 +20,9 @@ Buffer cmd_define_buf;
 bool preprocessing_only = false;
 bool compile_only = false;
 bool do_not_link = false;
+bool omit_frame_pointer = false;
+bool optimize = true;
+int parallel_jobs = 1;
 char* output_file = nullptr;
 vector<char*> include_path;
 vector<char*> libs;
@@ -40,13 +43,16 @@ static void usage() {
     "-D <name>[=def]          Predefine name as a macro\n"
     "-U <name>                Undefine name\n"
     "-l <library>             link library\n"
+    "-O0                      Do not optimize, only lay out the stack frames\n"
+    "-fomit-frame-pointer     Address locals from rsp in leaf functions\n"
+    "-fparallel-jobs=<n>      Generate the functions of a file on <n> threads\n"
     );
     exit(1);
 }
 
 static void arg_parse(int argc, char* argv[]) {
     while(true) {
-        int opt = getopt(argc, argv, "hESco:I:D:U:l:");
+        int opt = getopt(argc, argv, "hESco:I:D:U:l:f:O:");
         if(opt == -1) break;
         switch(opt) {
         case 'h': usage();
@@ -69,6 +75,21 @@ static void arg_parse(int argc, char* argv[]) {
             libs.push_back(optarg);
             break;
         }
+        case 'O': {
+            optimize = strcmp(optarg, "0") != 0;
+            break;
+        }
+        case 'f': {
+            if(!strcmp(optarg, "omit-frame-pointer"))
+                omit_frame_pointer = true;
+            else if(!strcmp(optarg, "no-omit-frame-pointer"))
+                omit_frame_pointer = false;
+            else if(!strncmp(optarg, "parallel-jobs=", 14) && atoi(optarg + 14) > 0)
+                parallel_jobs = atoi(optarg + 14);
+            else
+                usage();
+            break;
+        }
         default:
             usage();
         }
@@ -119,6 +140,11 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
     for(auto input_file:input_files) {
+        // everything built for this file is released with the arena
+        Arena arena;
+        Arena::current = &arena;
+        TypeTable types;
+        TypeTable::current = &types;
         Lexer lexer(input_file);
         if(cmd_define_buf.size() > 0) {
             lexer.get_fileset().push_string(cmd_define_buf.data());
@@ -145,6 +171,9 @@ int main(int argc, char* argv[]) {
         char* asm_file = replace_suffix(input_file, 's');
         asm_files.push_back(asm_file);
         Generator generator(asm_file, &parser);
+        generator.omit_frame_pointer = omit_frame_pointer;
+        generator.optimize = optimize;
+        generator.jobs = parallel_jobs;
         generator.run();
         if(compile_only) {
             continue;
@@ -0,0 +1,47 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <new>
+#include "arena.h"
+
+#define ARENA_CHUNK_SIZE (1 << 20)
+
+thread_local Arena* Arena::current = nullptr;
+
+void* Arena::alloc(size_t size, size_t align) {
+    uintptr_t p = ((uintptr_t)ptr + align - 1) & ~(uintptr_t)(align - 1);
+    if(!ptr || p + size > (uintptr_t)end) {
+        // big objects get a chunk of their own
+        size_t chunk_size = size + align > ARENA_CHUNK_SIZE ? size + align : ARENA_CHUNK_SIZE;
+        char* chunk = (char*)malloc(chunk_size);
+        if(!chunk)
+            throw std::bad_alloc();
+        chunks.push_back(chunk);
+        ptr = chunk;
+        end = chunk + chunk_size;
+        p = ((uintptr_t)ptr + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    ptr = (char*)(p + size);
+    return (void*)p;
+}
+
+void* Arena::grow(void* old, size_t old_size, size_t new_size) {
+    if((char*)old + old_size == ptr && (char*)old + new_size <= end) {
+        ptr = (char*)old + new_size;
+        return old;
+    }
+    void* p = alloc(new_size, 1);
+    memcpy(p, old, old_size);
+    return p;
+}
+
+void Arena::reset() {
+    for(auto chunk:chunks)
+        free(chunk);
+    chunks.clear();
+    ptr = end = nullptr;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    return arena ? arena->alloc(size) : ::operator new(size);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+/*
+Bump-pointer allocator for everything built while compiling one translation 
+unit: AST nodes, types, tokens and strings. Objects are never freed one by one, 
+the whole unit is released at once by reset() or when the arena is destroyed.
+*/
+class Arena {
+public:
+    Arena() {}
+    ~Arena() { 
+        reset(); 
+        if(current == this) current = nullptr;
+    }
+
+    void* alloc(size_t size, size_t align = alignof(max_align_t));
+    // extend the last allocation in place when there is room, otherwise move it
+    void* grow(void* ptr, size_t old_size, size_t new_size);
+    void reset();
+
+    // the arena this thread allocates from, null outside of a translation unit
+    static thread_local Arena* current;
+
+private:
+    std::vector<char*> chunks;
+    char* ptr = nullptr;
+    char* end = nullptr;
+};
+
+// Allocate from arena, or from the heap if it is null
+void* arena_alloc(Arena* arena, size_t size);
+
+// Allocator for std::allocate_shared. Deallocation is a no-op for arena memory.
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena* arena): arena(arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other): arena(other.arena) {}
+
+    T* allocate(size_t n) { 
+        return static_cast<T*>(arena ? arena->alloc(n * sizeof(T), alignof(T)) : ::operator new(n * sizeof(T))); 
+    }
+    void deallocate(T* p, size_t) {
+        if(!arena) ::operator delete(p);
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+public:
+    Arena* arena;
+};
+
+// make_shared in the current arena
+template<typename T, typename... Args>
+std::shared_ptr<T> arena_make(Args&&... args) {
+    return std::allocate_shared<T>(ArenaAllocator<T>(Arena::current), std::forward<Args>(args)...);
+}
@@ -12,8 +12,21 @@ char* make_tmpname() {
     return format(".T%d", c++);
 }
 
+// index of the function whose code this thread is generating in parallel, or -1
+static thread_local int label_func = -1;
+static thread_local int label_count = 0;
+
+// Labels of a function generated in parallel are numbered within the function,
+// so that the output does not depend on the order the functions are done in.
+void set_label_func(int func) {
+    label_func = func;
+    label_count = 0;
+}
+
 char* make_label() {
     static int c = 0;
+    if(label_func >= 0)
+        return format(".L%d.%d", label_func, label_count++);
     return format(".L%d", c++);
 }
 
@@ -23,14 +36,14 @@ char* make_static_label(char *name) {
 }
 
 std::shared_ptr<Node> error_node = 
-    std::shared_ptr<Node>(new Node(NK_ERROR, nullptr, nullptr));
+    arena_make<Node>(NK_ERROR, nullptr, nullptr);
  
 std::shared_ptr<IntNode> make_int_node(TokenPtr first_token, Type* type, long long value) {
-    return std::shared_ptr<IntNode>(new IntNode(first_token, type, value));
+    return arena_make<IntNode>(first_token, type, value);
 }
 
 std::shared_ptr<FloatNode> make_float_node(TokenPtr first_token, Type* type, double value) {
-    return std::shared_ptr<FloatNode>(new FloatNode(first_token, type, value));
+    return arena_make<FloatNode>(first_token, type, value);
 }
 
 std::shared_ptr<StringNode> make_string_node(TokenPtr first_token, char* str, int len, int encode_method) {
@@ -59,14 +72,15 @@ std::shared_ptr<StringNode> make_string_node(TokenPtr first_token, char* str, in
         break;
     }
     }
-    return std::shared_ptr<StringNode>(new StringNode(first_token, type, value));
+    return arena_make<StringNode>(first_token, type, value);
 }
 
 std::shared_ptr<LocalVarNode> make_localvar_node(TokenPtr first_token, Type* type, char* name, Scope* scope) {
     std::shared_ptr<LocalVarNode> node = 
-        std::shared_ptr<LocalVarNode>(new LocalVarNode(first_token, type, name));
+        arena_make<LocalVarNode>(first_token, type, name);
     if(scope->islocal()) {
-        scope->add(name, node); 
+        if(name)
+            scope->add(name, node); 
         scope->add_local_var(node);
     }
     return node;
@@ -74,7 +88,7 @@ std::shared_ptr<LocalVarNode> make_localvar_node(TokenPtr first_token, Type* typ
 
 std::shared_ptr<GlobalVarNode> make_globalvar_node(TokenPtr first_token, Type* type, char* name, Scope* scope) {
     std::shared_ptr<GlobalVarNode> node = 
-        std::shared_ptr<GlobalVarNode>(new GlobalVarNode(first_token, type, name));
+        arena_make<GlobalVarNode>(first_token, type, name);
     scope->add_global(name, node);
     return node;
 }
@@ -82,7 +96,7 @@ std::shared_ptr<GlobalVarNode> make_globalvar_node(TokenPtr first_token, Type* t
 std::shared_ptr<GlobalVarNode> make_static_localvar_node(TokenPtr first_token, Type* var_type, char* name, 
     Scope* scope) {
     std::shared_ptr<GlobalVarNode> node = 
-        std::shared_ptr<GlobalVarNode>(new GlobalVarNode(first_token, var_type, name));
+        arena_make<GlobalVarNode>(first_token, var_type, name);
     node->global_label = make_static_label(name);
     assert(scope->islocal());
     scope->add(name, node);
@@ -90,12 +104,12 @@ std::shared_ptr<GlobalVarNode> make_static_localvar_node(TokenPtr first_token, T
 }
 
 std::shared_ptr<FuncDesignatorNode> make_func_designator_node(TokenPtr first_token, Type* type, char* name) {
-    return std::shared_ptr<FuncDesignatorNode>(new FuncDesignatorNode(first_token, type, name)) ;
+    return arena_make<FuncDesignatorNode>(first_token, type, name) ;
 }
 
 std::shared_ptr<TypedefNode> make_typedef_node(TokenPtr first_token, Type* type, char* name, Scope* scope) {
     std::shared_ptr<TypedefNode> node = 
-        std::shared_ptr<TypedefNode>(new TypedefNode(first_token, type, name));
+        arena_make<TypedefNode>(first_token, type, name);
     if(scope)
         scope->add(name, node);
     return node;
@@ -103,7 +117,7 @@ std::shared_ptr<TypedefNode> make_typedef_node(TokenPtr first_token, Type* type,
 
 std::shared_ptr<UnaryOperNode> make_unary_oper_node(TokenPtr first_token, int kind, 
     Type* type, std::shared_ptr<Node> operand) {
-    return std::shared_ptr<UnaryOperNode>(new UnaryOperNode(first_token, kind, type, operand));
+    return arena_make<UnaryOperNode>(first_token, kind, type, operand);
 }
 
 std::shared_ptr<BinaryOperNode> make_binary_oper_node(TokenPtr first_token, int kind, Type* type, 
@@ -117,62 +131,70 @@ std::shared_ptr<FuncCallNode> make_func_call_node(TokenPtr first_token, std::sha
     assert(func_desg->kind == NK_FUNC_DESG);
     std::shared_ptr<FuncDesignatorNode> node = 
         std::dynamic_pointer_cast<FuncDesignatorNode>(func_desg);
-    return std::shared_ptr<FuncCallNode>(new FuncCallNode(first_token, 
-        NK_FUNC_CALL, node->func_name, dynamic_cast<FuncType*>(node->type), nullptr, args));
+    return arena_make<FuncCallNode>(first_token, 
+        NK_FUNC_CALL, node->func_name, dynamic_cast<FuncType*>(node->type), nullptr, args);
 }
 
 std::shared_ptr<FuncCallNode> make_funcptr_call_node(TokenPtr first_token, std::shared_ptr<Node> func_ptr, 
     Type* func_type, std::vector<std::shared_ptr<Node>> args) {
     assert(func_type->kind == TK_FUNC);
     FuncType* ftype = dynamic_cast<FuncType*>(func_type);
-    return std::shared_ptr<FuncCallNode>(new FuncCallNode(first_token, 
-        NK_FUNCPTR_CALL, nullptr, ftype, func_ptr, args));
+    return arena_make<FuncCallNode>(first_token, 
+        NK_FUNCPTR_CALL, nullptr, ftype, func_ptr, args);
 }
 
 std::shared_ptr<StructMemberNode> make_struct_member_node(TokenPtr first_token, Type* field_type, NodePtr struc, 
     char* field_name) {
-    return std::shared_ptr<StructMemberNode>(new StructMemberNode(first_token, field_type, struc, field_name));
+    return arena_make<StructMemberNode>(first_token, field_type, struc, field_name);
 }
 
 std::shared_ptr<LabelAddrNode> make_label_addr_node(TokenPtr first_token, char* label) {
-    return std::shared_ptr<LabelAddrNode>(new LabelAddrNode(first_token, label));
+    return arena_make<LabelAddrNode>(first_token, label);
 }
 
 std::shared_ptr<TernaryOperNode> make_ternary_oper_node(TokenPtr first_token, Type* type, std::shared_ptr<Node> cond, 
     std::shared_ptr<Node> then, std::shared_ptr<Node> els) {
-    return std::shared_ptr<TernaryOperNode>(new TernaryOperNode(first_token, type, cond, then, els));
+    return arena_make<TernaryOperNode>(first_token, type, cond, then, els);
 }
 
 std::shared_ptr<InitNode> make_init_node(TokenPtr first_token, Type* type, std::shared_ptr<Node> value, int offset) {
-    return std::shared_ptr<InitNode>(new InitNode(first_token, type, value, offset));
+    return arena_make<InitNode>(first_token, type, value, offset);
 }
 
 std::shared_ptr<DeclNode> make_decl_node(TokenPtr first_token, Type* type, std::shared_ptr<Node> var) {
-    return std::shared_ptr<DeclNode>(new DeclNode(first_token, type, var));
+    return arena_make<DeclNode>(first_token, type, var);
 }
 
 std::shared_ptr<CompoundStmtNode> make_compound_stmt_node(TokenPtr first_token, std::vector<NodePtr> list) {
-    return std::shared_ptr<CompoundStmtNode>(new CompoundStmtNode(first_token, list));
+    return arena_make<CompoundStmtNode>(first_token, list);
 }
 
 std::shared_ptr<IfNode> make_if_node(TokenPtr first_token, NodePtr cond, NodePtr then, NodePtr els) {
-    return std::shared_ptr<IfNode>(new IfNode(first_token, cond, then, els)); 
+    return arena_make<IfNode>(first_token, cond, then, els); 
 }
 
 std::shared_ptr<LabelNode> make_label_node(TokenPtr first_token, char* origin_label, char* normal_label) {
-    return std::shared_ptr<LabelNode>(new LabelNode(first_token, origin_label, normal_label));     
+    return arena_make<LabelNode>(first_token, origin_label, normal_label);     
 } 
 
 std::shared_ptr<JumpNode> make_jump_node(TokenPtr first_token, char* origin_label, char* normal_label) {
-    return std::shared_ptr<JumpNode>(new JumpNode(first_token, origin_label, normal_label));     
+    return arena_make<JumpNode>(first_token, origin_label, normal_label);     
+}
+
+std::shared_ptr<JumpTableNode> make_jump_table_node(TokenPtr first_token, NodePtr var, long long min, std::vector<char*> labels, char* default_label) {
+    return arena_make<JumpTableNode>(first_token, var, min, labels, default_label);     
+} 
+
+std::shared_ptr<VectorLoopNode> make_vector_loop_node(TokenPtr first_token, Type* elem_type, NodePtr var, NodePtr bound) {
+    return arena_make<VectorLoopNode>(first_token, elem_type, var, bound);     
 } 
 
 std::shared_ptr<ReturnNode> make_return_node(TokenPtr first_token, NodePtr return_val) {
-    return std::shared_ptr<ReturnNode>(new ReturnNode(first_token, return_val));     
+    return arena_make<ReturnNode>(first_token, return_val);     
 }
 
 std::shared_ptr<FuncDefNode> make_func_def_node(TokenPtr first_token, Type* func_type, char* func_name, std::vector<NodePtr> params, NodePtr body, Scope* scope) {
-    return std::shared_ptr<FuncDefNode>(new FuncDefNode(first_token, func_type, func_name, params, body, scope->get_local_vars()));        
+    return arena_make<FuncDefNode>(first_token, func_type, func_name, params, body, scope->get_local_vars());        
 }
  
 // evaluate integer constant expression
@@ -543,6 +565,28 @@ char* JumpNode::to_dot_graph(FILE* fout) {
     return id;  
 }
 
+char* JumpTableNode::to_dot_graph(FILE* fout) {
+    char* id = make_point_id();
+    fprintf(fout, "%s[label=\"{<head>jump_table|null|<var>var|min:%lld|size:%d|default:%s}\"];\n", 
+        id, min, (int)labels.size(), default_label);
+    if(var) {
+        char* child_id = var->to_dot_graph(fout);
+        fprintf(fout, "%s:var -> %s:head;\n", id, child_id);
+    }
+    return id;  
+}
+
+char* VectorLoopNode::to_dot_graph(FILE* fout) {
+    char* id = make_point_id();
+    fprintf(fout, "%s[label=\"{<head>vector_loop|<type>%s|<var>var|<bound>bound|arrays:%d|scalars:%d}\"];\n", 
+        id, ty2s(elem_type), (int)arrays.size(), (int)scalars.size());
+    char* child_id = var->to_dot_graph(fout);
+    fprintf(fout, "%s:var -> %s:head;\n", id, child_id);
+    child_id = bound->to_dot_graph(fout);
+    fprintf(fout, "%s:bound -> %s:head;\n", id, child_id);
+    return id;  
+}
+
 char* ReturnNode::to_dot_graph(FILE* fout) {
     char* id = make_point_id();
     fprintf(fout, "%s[label=\"{<head>return|null|<value>value}\"];\n", id);    
@@ -17,6 +17,7 @@ using TokenPtr = std::shared_ptr<Token>;
 
 char* make_tmpname();
 char* make_label();
+void set_label_func(int func);
 char* make_static_label(char *name);
 
 enum NodeKind {
@@ -38,10 +39,12 @@ enum NodeKind {
     NK_DECL,
     NK_IF,
     NK_JUMP,
+    NK_JUMP_TABLE,
     NK_LABEL,
     NK_COMPOUND_STMT,
     NK_RETURN,
     NK_FUNC_DEF,
+    NK_VECTOR_LOOP,
 
     NK_CAST, // explicit conversion
     NK_CONV, // implicit conversion
@@ -110,7 +113,6 @@ public:
     virtual char* to_dot_graph(FILE* fout);
 public:
     double value;
-    char* label = nullptr;
 };
 
 class StringNode: public Node {
@@ -138,6 +140,8 @@ public:
 public:
     char* var_name;
     int offset;
+    // offset within the local area of the function, assigned by the optimizer
+    int slot = 0;
     std::vector<NodePtr> init_list;
 };
 
@@ -244,6 +248,8 @@ public:
     FuncType* func_type;
     NodePtr func_ptr;
     std::vector<NodePtr> args;
+    // "return f(args)" that reuses the frame of the caller, marked by the optimizer
+    bool is_tail_call = false;
 };
 
 class StructMemberNode: public Node {
@@ -355,6 +361,52 @@ public:
     char* normal_label;
 };
 
+// Indexed jump used to dispatch dense switch statements: 
+// goto labels[var - min] if it is in range, otherwise goto default_label
+class JumpTableNode: public Node {
+public:
+    JumpTableNode(TokenPtr first_token, NodePtr var, long long min, 
+        std::vector<char*> labels, char* default_label): 
+        Node(NK_JUMP_TABLE, nullptr, first_token), var(var), 
+        min(min), labels(labels), default_label(default_label) {}
+
+    virtual void codegen(Generator& gen);
+
+    virtual char* to_dot_graph(FILE* fout);
+public:
+    NodePtr var;
+    long long min;
+    std::vector<char*> labels;
+    char* default_label;
+};
+
+// Packed SSE2 form of a counted loop, created by the optimizer in front of the scalar 
+// loop which then does the remaining iterations. While var + lanes <= bound, it computes
+// code on 16 bytes of elements and stores them to dst[var] or adds them to acc.
+class VectorLoopNode: public Node {
+public:
+    // opcodes of code besides the operators
+    enum { VEC_LOAD = -1, VEC_SCALAR = -2 };
+
+    VectorLoopNode(TokenPtr first_token, Type* elem_type, NodePtr var, NodePtr bound): 
+        Node(NK_VECTOR_LOOP, nullptr, first_token), 
+        elem_type(elem_type), var(var), bound(bound) {}
+
+    virtual void codegen(Generator& gen);
+
+    virtual char* to_dot_graph(FILE* fout);
+public:
+    Type* elem_type;
+    NodePtr var, bound;
+    NodePtr dst, acc;
+    // base pointers of the loaded arrays, and the operands broadcast to all lanes
+    std::vector<NodePtr> arrays, scalars;
+    // postfix: (VEC_LOAD, index of arrays), (VEC_SCALAR, index of scalars) or (operator, 0)
+    std::vector<std::pair<int, int>> code;
+    // whether dst may partially overlap the loaded arrays
+    bool check_alias = true;
+};
+
 class ReturnNode: public Node {
 public:
     ReturnNode(TokenPtr first_token, NodePtr return_val): 
@@ -383,6 +435,9 @@ public:
     std::vector<NodePtr> params;
     NodePtr body;
     std::vector<NodePtr> local_vars;
+    int local_area = 0;
+    // false when every path through the body ends in a return
+    bool reaches_end = true;
 };
 
 extern NodePtr error_node;
@@ -408,6 +463,8 @@ std::shared_ptr<CompoundStmtNode> make_compound_stmt_node(TokenPtr first_token,
 std::shared_ptr<IfNode> make_if_node(TokenPtr first_token, NodePtr cond, NodePtr then, NodePtr els);
 std::shared_ptr<LabelNode> make_label_node(TokenPtr first_token, char* origin_label, char* normal_label = nullptr);
 std::shared_ptr<JumpNode> make_jump_node(TokenPtr first_token, char* origin_label, char* normal_label = nullptr);
+std::shared_ptr<JumpTableNode> make_jump_table_node(TokenPtr first_token, NodePtr var, long long min, std::vector<char*> labels, char* default_label);
+std::shared_ptr<VectorLoopNode> make_vector_loop_node(TokenPtr first_token, Type* elem_type, NodePtr var, NodePtr bound);
 std::shared_ptr<ReturnNode> make_return_node(TokenPtr first_token, NodePtr return_val);
 std::shared_ptr<FuncDefNode> make_func_def_node(TokenPtr first_token, Type* func_type, char* func_name, std::vector<NodePtr> params, NodePtr body, Scope* scope);
 
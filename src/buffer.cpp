@@ -3,13 +3,17 @@
 #include <string.h>
 #include "buffer.h"
 
-Buffer::Buffer(): size_(0), cap_(8) {
-    data_ = (char*)malloc(cap_);
+Buffer::Buffer(): size_(0), cap_(8), arena_(Arena::current) {
+    data_ = arena_ ? (char*)arena_->alloc(cap_, 1) : (char*)malloc(cap_);
 }
 
 void Buffer::realloc() {
-    cap_ += cap_ >> 1;  /* cap * 1.5 */
-    data_ = (char*)::realloc(data_, cap_);
+    int cap = cap_ + (cap_ >> 1);  /* cap * 1.5 */
+    if(arena_)
+        data_ = (char*)arena_->grow(data_, cap_, cap);
+    else
+        data_ = (char*)::realloc(data_, cap);
+    cap_ = cap;
 }
 
 void Buffer::write(char c) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include "arena.h"
 
 class Buffer {
 public:
@@ -21,4 +22,6 @@ private:
     char* data_;
     int size_;
     int cap_;
+    // where data_ is allocated, the heap if null
+    Arena* arena_;
 };
\ No newline at end of file
@@ -1,40 +1,100 @@
 #include <unistd.h>
 #include <string.h>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "file.h"
 
-void FileSet::push_file(FILE* file, char* name) {
+/*
+The scans look at FILE_PADDING bytes at a time. They never run
+past the end, because the contents are followed by zeros and '\0'
+always stops them.
+*/
+
+// first byte of p in set or '\0'
+static char* find_any(char* p, const char* set) {
+#ifdef __SSE2__
+    int n = strlen(set);
+    __m128i zero = _mm_setzero_si128();
+    while(true) {
+        __m128i block = _mm_loadu_si128((__m128i*)p);
+        __m128i hit = _mm_cmpeq_epi8(block, zero);
+        for(int i = 0; i < n; ++i)
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, _mm_set1_epi8(set[i])));
+        int mask = _mm_movemask_epi8(hit);
+        if(mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#else
+    return p + strcspn(p, set);
+#endif
+}
+
+// first byte of p not in set
+static char* skip_any(char* p, const char* set) {
+#ifdef __SSE2__
+    int n = strlen(set);
+    while(true) {
+        __m128i block = _mm_loadu_si128((__m128i*)p);
+        __m128i hit = _mm_setzero_si128();
+        for(int i = 0; i < n; ++i)
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, _mm_set1_epi8(set[i])));
+        int mask = ~_mm_movemask_epi8(hit) & 0xffff;
+        if(mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#else
+    return p + strspn(p, set);
+#endif
+}
+
+void FileSet::push(char* data, size_t len, char* name) {
+    memset(data + len, 0, FILE_PADDING);
+
     File f;
-    f.file = file;
+    f.data = data;
+    f.stream = data;
+    f.end = data + len;
     f.name = name;
-    f.row = 1;
-    f.col = 1;
-    f.last_col = 1;
+    f.last_line = 0;
+    f.line_delta = 0;
     files.push_back(f);
 }
 
+void FileSet::push_file(FILE* file, char* name) {
+    size_t cap = 4096, len = 0;
+    char* data = (char*)malloc(cap + FILE_PADDING);
+    size_t n;
+    while((n = fread(data + len, 1, cap - len, file)) > 0) {
+        len += n;
+        if(len == cap) {
+            cap *= 2;
+            data = (char*)realloc(data, cap + FILE_PADDING);
+        }
+    }
+    fclose(file);
+    push(data, len, name);
+}
+
 void FileSet::push_string(char* s) {
-    File f;
-    f.file = nullptr;
-    f.stream = s;
-    f.name = nullptr;
-    f.row = 1;
-    f.col = 1;
-    files.push_back(f);
+    size_t len = strlen(s);
+    char* data = (char*)malloc(len + FILE_PADDING);
+    memcpy(data, s, len);
+    push(data, len, nullptr);
 }
 
 void FileSet::pop_file() {
     File& f = files.back();
-    if(f.file) {
-        fclose(f.file);
-    }
+    free(f.data);
     files.pop_back();
 }
 
 FileSet::~FileSet() {
-    for(auto f:files) {
-        if(f.file) {
-            fclose(f.file);
-        }
+    for(auto& f:files) {
+        free(f.data);
     }
 }
 
@@ -47,37 +107,17 @@ int FileSet::get_chr_aux() {
         c = buf.back();
         buf.pop_back();
     }
-    else if(f.file) { // from file
-        c = ::getc(f.file);
+    else if(f.stream == f.end) {
+        c = EOF;
+    }
+    else {
+        c = (unsigned char)*f.stream++;
         // "\r\n" or "\r" are considered as "\n"
         if(c == '\r') {
-            int c1 = ::getc(f.file);
-            if(c1 != '\n')
-                ::ungetc(c1, f.file);
-            c = '\n';
-        }
-    } 
-    else { // from stringstream
-        c = *f.stream;
-        if(c == '\0') c = EOF;
-        else if(c == '\r') {
-            ++f.stream;
-            if(*f.stream == '\n')
+            if(f.stream != f.end && *f.stream == '\n')
                 ++f.stream;
             c = '\n';
         }
-        else {
-            ++f.stream;
-        }
-    }
-
-    if(c == '\n') {
-        ++f.row;
-        f.last_col = f.col;
-        f.col = 1;
-    }
-    else if(c != EOF) {
-        ++f.col;
     }
     return c;
 }
@@ -96,7 +136,7 @@ int FileSet::get_chr() {
         else {
             int c1 = get_chr_aux();
             // '\' immediately followed by a new-line character is deleted
-            if(c1 == '\n') 
+            if(c1 == '\n')
                 continue;
             unget_chr(c1);
             return c;
@@ -108,15 +148,6 @@ void FileSet::unget_chr(int c) {
     if(c == EOF)
         return;
     buf.push_back(c);
-
-    File& f = current_file();
-    if(c == '\n') {
-        --f.row;
-        f.col = f.last_col;
-    }
-    else if(c != EOF) {
-        --f.col;
-    }
 }
 
 int FileSet::peek() {
@@ -125,11 +156,86 @@ int FileSet::peek() {
     return c;
 }
 
-// test if the next character is expected 
+// test if the next character is expected
 bool FileSet::next(int expected) {
     int c = get_chr();
     if(c == expected)
         return true;
     unget_chr(c);
     return false;
-}
\ No newline at end of file
+}
+
+// the characters in buf were read right before stream
+char* FileSet::read_pos(File& f) {
+    char* p = f.stream;
+    for(size_t i = 0; i < buf.size() && p > f.data; ++i) {
+        if(p - f.data >= 2 && p[-1] == '\n' && p[-2] == '\r')
+            p -= 2;
+        else
+            --p;
+    }
+    return p;
+}
+
+void FileSet::get_pos(int* row, int* col) {
+    File& f = current_file();
+    if(f.lines.empty()) {
+        f.lines.push_back(f.data);
+        for(char* p = f.data; (p = find_any(p, "\n\r")) < f.end; ++p) {
+            if(*p == '\n' || (*p == '\r' && p[1] != '\n'))
+                f.lines.push_back(p + 1);
+        }
+    }
+
+    char* p = read_pos(f);
+    size_t i = f.last_line;
+    // positions mostly move forward within a line or to the next one
+    if(p < f.lines[i] || (i + 1 < f.lines.size() && p >= f.lines[i + 1])) {
+        if(i + 2 < f.lines.size() && p >= f.lines[i + 1] && p < f.lines[i + 2])
+            ++i;
+        else
+            i = std::upper_bound(f.lines.begin(), f.lines.end(), p) - f.lines.begin() - 1;
+        f.last_line = i;
+    }
+    *row = i + 1 + f.line_delta;
+    *col = p - f.lines[i] + 1;
+}
+
+bool FileSet::at_line_start() {
+    File& f = current_file();
+    char* p = read_pos(f);
+    return p == f.data || p[-1] == '\n' || p[-1] == '\r';
+}
+
+// the line after #line is numbered row
+void FileSet::set_row(int row) {
+    int cur, col;
+    get_pos(&cur, &col);
+    current_file().line_delta += row - cur;
+}
+
+void FileSet::skip_chars(const char* stops) {
+    if(buf.size() > 0)
+        return;
+    // '\r' and '\\' need get_chr for line endings and splices
+    char set[32] = "\n\r\\";
+    strncat(set, stops, sizeof(set) - strlen(set) - 1);
+
+    File& f = current_file();
+    f.stream = std::min(find_any(f.stream, set), f.end);
+}
+
+void FileSet::skip_blanks() {
+    if(buf.size() > 0)
+        return;
+    File& f = current_file();
+    f.stream = std::min(skip_any(f.stream, " \t\v\f"), f.end);
+}
+
+void FileSet::skip_to(int c) {
+    if(buf.size() > 0)
+        return;
+    char set[] = { (char)c, '\0' };
+    File& f = current_file();
+    f.stream = std::min(find_any(f.stream, set), f.end);
+}
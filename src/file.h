@@ -4,14 +4,19 @@
 #include <stdlib.h>
 #include <vector>
 
+// bytes of zeros after the contents, so scans can load a block at any position
+#define FILE_PADDING 16
+
 struct File {
     char* name;
-    int row;
-    int col;
-    int last_col;
-    // one of file and stream will be null
-    FILE* file;
-    char* stream; // maybe read by stringstream
+    // files and strings are copied into data in one go, stream is the read position
+    char* data;
+    char* stream;
+    char* end;
+    // start of each line, built on the first position query
+    std::vector<char*> lines;
+    size_t last_line;
+    int line_delta; // set by #line
 };
 
 class FileSet {
@@ -35,10 +40,24 @@ public:
     int peek();
     bool next(int c);
 
+    // position of the next character
+    void get_pos(int* row, int* col);
+    bool at_line_start();
+    void set_row(int row);
+
+    // consume characters up to the next newline or one of stops
+    void skip_chars(const char* stops);
+    // consume blanks other than newline
+    void skip_blanks();
+    // consume characters, newlines included, up to the next c
+    void skip_to(int c);
+
 private:
     int get_chr_aux();
+    void push(char* data, size_t len, char* name);
+    char* read_pos(File& f);
 
 private:
     std::vector<File> files;
     std::vector<int> buf;
-};
\ No newline at end of file
+};
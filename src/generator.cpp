@@ -1,20 +1,29 @@
 #include <stdlib.h>
 #include <fstream>
+#include <sstream>
 #include <assert.h>
 #include <algorithm>
+#include <thread>
+#include <atomic>
 #include "ast.h"
 #include "error.h"
 #include "generator.h"
+#include "optimizer.h"
 using namespace std;
 
 // (6 ∗ 8 + 8 ∗ 16) = 176
 #define REG_SAVE_AREA_SIZE 176
 
+// Blocks up to this size are copied or zeroed with unrolled 16-byte SSE2 moves,
+// larger ones with rep movs/stos
+#define BLOCK_UNROLL_MAX 256
+
 // according to linux x86_64-abi: 
 // User-level applications use as integer registers for passing the sequence
 // %rdi, %rsi, %rdx, %rcx, %r8 and %r9.
 // Floating point arguments are placed in the registers %xmm0-%xmm7
 static char* REGS[6] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"}; 
+static char* REGS_LOW[6] = {"dil", "sil", "dl", "cl", "r8b", "r9b"}; 
 // static char* XMMS[8] = {"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"};
 
 #ifdef DEBUG_MODE
@@ -29,6 +38,10 @@ Generator::Generator(char* filename, Parser* parser): parser(parser), fout(filen
     fout.setf(ios::fixed);
 }
 
+Generator::Generator(Parser* parser): parser(parser) {
+    fout.setf(ios::fixed);
+}
+
 void Generator::emit_noindent(char* fmt) {
     fout << fmt << endl;
 }
@@ -59,6 +72,7 @@ void Generator::emit(char* fmt, Args ... args) {
 void Generator::push(char* reg) {
     emit("push %?", reg);
     stack_size += 8;
+    max_stack_size = max(max_stack_size, stack_size);
 }
 
 void Generator::pop(char* reg) {
@@ -71,6 +85,7 @@ void Generator::push_xmm(int xmm_id) {
     emit("sub $8, %rsp");
     emit("movsd %xmm?, (%rsp)", xmm_id);
     stack_size += 8;
+    max_stack_size = max(max_stack_size, stack_size);
 }
 
 void Generator::pop_xmm(int xmm_id) {
@@ -85,18 +100,92 @@ static inline int align8(int size) {
     return (m == 0) ? size : size - m + 8;
 }
 
+static const char* R11[9] = {nullptr, "r11b", "r11w", nullptr, "r11d", nullptr, nullptr, nullptr, "r11"};
+
+// Copy size bytes from (%src) to (%dst), r11 and xmm15 are clobbered
+void Generator::emit_block_copy(char* src, char* dst, int size) {
+    if(size > BLOCK_UNROLL_MAX) {
+        push("rcx");
+        push("rsi");
+        push("rdi");
+        emit("movq %?, %rsi", src);
+        if(!strcmp(dst, "rsp"))
+            emit("lea 24(%rsp), %rdi");
+        else
+            emit("movq %?, %rdi", dst);
+        emit("movq $?, %rcx", size);
+        emit("rep movsb");
+        pop("rdi");
+        pop("rsi");
+        pop("rcx");
+        return;
+    }
+    int i = 0;
+    if(size >= 16) {
+        for(; i + 16 <= size; i += 16) {
+            emit("movdqu ?(%?), %xmm15", i, src);
+            emit("movdqu %xmm15, ?(%?)", i, dst);
+        }
+        // the last move overlaps the previous one
+        if(i < size) {
+            emit("movdqu ?(%?), %xmm15", size - 16, src);
+            emit("movdqu %xmm15, ?(%?)", size - 16, dst);
+        }
+        return;
+    }
+    for(int n = 8; n > 0; n /= 2) {
+        for(; i + n <= size; i += n) {
+            emit("mov ?(%?), %?", i, src, R11[n]);
+            emit("mov %?, ?(%?)", R11[n], i, dst);
+        }
+    }
+}
+
+// Zero size bytes at offset(%base), xmm15 is clobbered
+void Generator::emit_block_zero(char* base, int offset, int size) {
+    if(frame_omitted && !strcmp(base, "rbp")) {
+        base = "rsp";
+        offset += stack_size - 8;
+    }
+    if(size > BLOCK_UNROLL_MAX) {
+        push("rax");
+        push("rcx");
+        push("rdi");
+        emit("lea ?(%?), %rdi", strcmp(base, "rsp") ? offset : offset + 24, base);
+        emit("xor %eax, %eax");
+        emit("movq $?, %rcx", size / 8);
+        emit("rep stosq");
+        pop("rdi");
+        pop("rcx");
+        pop("rax");
+        offset += size / 8 * 8;
+        size %= 8;
+    }
+    else if(size >= 16) {
+        emit("pxor %xmm15, %xmm15");
+        int i = 0;
+        for(; i + 16 <= size; i += 16)
+            emit("movdqu %xmm15, ?(%?)", offset + i, base);
+        if(i < size)
+            emit("movdqu %xmm15, ?(%?)", offset + size - 16, base);
+        return;
+    }
+    int end = offset + size;
+    for(; offset <= end - 8; offset += 8)
+        emit("movq $0, ?(%?)", offset, base);
+    for(; offset <= end - 4; offset += 4)
+        emit("movl $0, ?(%?)", offset, base);
+    for(; offset < end; ++offset)
+        emit("movb $0, ?(%?)", offset, base);
+}
+
 // Structure address is stored in rax
 int Generator::push_struct(int size) {
     int aligned_size = align8(size);
-    emit("sub ?, %rsp", aligned_size);
-    emit("movq %rcx, -8(%rsp)");
-    int i = 0;
-    for(; i < aligned_size; i += 8) {
-        emit("movq ?(%rax), %rcx", i);
-        emit("movq %rcx, ?(%rsp)", i);
-    }
-    emit("movq -8(%rsp), %rcx");
+    emit("sub $?, %rsp", aligned_size);
     stack_size += aligned_size;
+    max_stack_size = max(max_stack_size, stack_size);
+    emit_block_copy("rax", "rsp", size);
     return aligned_size;
 }
 
@@ -113,26 +202,23 @@ static const char* get_reg(Type* type, char r) {
 }
 
 void Generator::emit_bitfield_load(Type* type) {
-    push("rcx");
     emit("shr $?, %rax", type->bitoff);
-    emit("mov $?, %rcx", (uint64_t)(1 << type->bitsize) - 1);
-    emit("and %rcx, %rax");
-    pop("rcx");
+    emit("mov $?, %r11", (uint64_t)(1 << type->bitsize) - 1);
+    emit("and %r11, %rax");
 }
 
-// The result has not been saved to memory
+static const char* R10[9] = {nullptr, "r10b", "r10w", nullptr, "r10d", nullptr, nullptr, nullptr, "r10"};
+
+// The result has not been saved to memory.
+// Nothing is pushed, addr may be relative to rsp
 void Generator::emit_bitfield_save(Type* type, char* addr) {
-    push("rcx");
-    push("rdi");
-    emit("mov $?, %rdi", (uint64_t)(1 << type->bitsize) - 1);
-    emit("and %rdi, %rax");
+    emit("mov $?, %r11", (uint64_t)(1 << type->bitsize) - 1);
+    emit("and %r11, %rax");
     emit("shl $?, %rax", type->bitoff);
-    emit("mov ?, %?", addr, get_reg(type, 'c'));
-    emit("mov $?, %rdi", ~(((uint64_t)(1 << type->bitsize) - 1) << type->bitoff));
-    emit("and %rdi, %rcx");
-    emit("or %rcx, %rax");
-    pop("rdi");
-    pop("rcx");
+    emit("mov ?, %?", addr, R10[type->size]);
+    emit("mov $?, %r11", ~(((uint64_t)(1 << type->bitsize) - 1) << type->bitoff));
+    emit("and %r11, %r10");
+    emit("or %r10, %rax");
 }
 
 void Generator::emit_int_to_int64(Type* type) {
@@ -171,11 +257,12 @@ void Generator::emit_float_to_int(Type* type) {
 
 void Generator::emit_to_bool(Type *type) {
     if(type->is_float_type()) {
-        push_xmm(1);
-        emit("xorpd %xmm1, %xmm1");
-        emit("%s %xmm1, %xmm0", (type->kind == TK_FLOAT) ? "ucomiss" : "ucomisd");
+        // NaN is unordered and converts to 1
+        emit("xorpd %xmm15, %xmm15");
+        emit("? %xmm15, %xmm0", (type->kind == TK_FLOAT) ? "ucomiss" : "ucomisd");
         emit("setne %al");
-        pop_xmm(1);
+        emit("setp %r11b");
+        emit("or %r11b, %al");
     }
     else {
         emit("cmp $0, %rax");
@@ -230,21 +317,22 @@ const char* Generator::get_mov_inst(Type *type) {
 }
 
 void Generator::emit_local_load(Type* type, char* base, int offset) {
+    char* addr = strcmp(base, "rbp") ? format("%d(%%%s)", offset, base) : local_addr(offset);
     switch(type->kind) {
     case TK_FLOAT:
-        emit("movss ?(%?), %xmm0", offset, base); break;
+        emit("movss ?, %xmm0", addr); break;
     case TK_DOUBLE:
     case TK_LONG_DOUBLE:
-        emit("movsd ?(%?), %xmm0", offset, base); break;
+        emit("movsd ?, %xmm0", addr); break;
     case TK_ARRAY:
     case TK_STRUCT:
-        emit("lea ?(%?), %rax", offset, base); break;
+        emit("lea ?, %rax", addr); break;
     default: {
         const char* inst = get_mov_inst(type);
         if(inst == nullptr) 
-            emit("movl ?(%?), %eax", offset, base);
+            emit("movl ?, %eax", addr);
         else 
-            emit("? ?(%?), %rax", inst, offset, base);
+            emit("? ?, %rax", inst, addr);
         if(type->bitsize > 0) 
             emit_bitfield_load(type);
     }
@@ -254,14 +342,14 @@ void Generator::emit_local_load(Type* type, char* base, int offset) {
 void Generator::emit_local_save(Type* type, int offset) {
     switch(type->kind) {
     case TK_FLOAT:
-        emit("movss %xmm0, ?(%rbp)", offset); break;
+        emit("movss %xmm0, ?", local_addr(offset)); break;
     case TK_DOUBLE:
     case TK_LONG_DOUBLE:
-        emit("movsd %xmm0, ?(%rbp)", offset); break;
+        emit("movsd %xmm0, ?", local_addr(offset)); break;
     default: {
         emit_bool_conv(type);
         const char* reg = get_reg(type, 'a');
-        char* addr = format("%d(%%rbp)", offset);
+        char* addr = local_addr(offset);
         if(type->bitsize > 0) 
             emit_bitfield_save(type, addr);
         emit("mov %?, ?", reg, addr);
@@ -300,32 +388,43 @@ void Generator::emit_global_save(Type* type, char* label, int offset) {
     emit("mov %?, ?", reg, addr);
 }
 
+// movq can only store a sign-extended imm32 to memory
+void Generator::emit_quad_save(int64_t value, int offset) {
+    if(value < INT32_MIN || value > INT32_MAX) {
+        emit("movq $?, %rax", value);
+        emit("movq %rax, ?", local_addr(offset));
+    }
+    else {
+        emit("movq $?, ?", value, local_addr(offset));
+    }
+}
+
 // Save literal values directly to memory
 void Generator::emit_literal_save(NodePtr node, Type* totype, int offset) {
     switch(totype->kind) {
     case TK_BOOL:  
-        emit("movb $?, ?(%rbp)", !!node->eval_int(), offset); break;
+        emit("movb $?, ?", !!node->eval_int(), local_addr(offset)); break;
     case TK_CHAR:  
-        emit("movb $?, ?(%rbp)", node->eval_int(), offset); break;
+        emit("movb $?, ?", node->eval_int(), local_addr(offset)); break;
     case TK_SHORT: 
-        emit("movw $?, ?(%rbp)", node->eval_int(), offset); break;
+        emit("movw $?, ?", node->eval_int(), local_addr(offset)); break;
     case TK_INT:   
-        emit("movl $?, ?(%rbp)", node->eval_int(), offset); break;
+        emit("movl $?, ?", node->eval_int(), local_addr(offset)); break;
     case TK_LONG:
     case TK_LONG_LONG:
     case TK_PTR: {
-        emit("movq $?, ?(%rbp)", (uint64_t)(node->eval_int()), offset);
+        emit_quad_save(node->eval_int(), offset);
         break;
     }
     case TK_FLOAT: {
         float d = node->eval_float();
-        emit("movl $?, ?(%rbp)", *(uint32_t *)(&d), offset);
+        emit("movl $?, ?", *(uint32_t *)(&d), local_addr(offset));
         break;
     }
     case TK_DOUBLE:
     case TK_LONG_DOUBLE: {
         double d = node->eval_float();
-        emit("movq $?, ?(%rbp)", *(uint64_t *)(&d), offset);
+        emit_quad_save(*(int64_t *)(&d), offset);
         break;
     }
     default:
@@ -335,19 +434,11 @@ void Generator::emit_literal_save(NodePtr node, Type* totype, int offset) {
 
 void Generator::emit_decl_init(vector<NodePtr>& init_list, int offset, int total_size) {
     int last_end = 0;
-    auto emit_zero = [&](int start, int end) {
-        for(; start <= end - 8; start += 8)
-            emit("movq $0, ?(%rbp)", start);
-        for(; start <= end - 4; start += 4)
-            emit("movl $0, ?(%rbp)", start);
-        for(; start < end; ++start)
-            emit("movb $0, ?(%rbp)", start);
-    };
     for(auto item:init_list) {
         shared_ptr<InitNode> init = dynamic_pointer_cast<InitNode>(item);
         // file zero 
         if(init->offset > last_end) {
-            emit_zero(offset + last_end, offset + init->offset);
+            emit_block_zero("rbp", offset + last_end, init->offset - last_end);
         }
         last_end = init->offset + init->type->size;
 
@@ -360,7 +451,7 @@ void Generator::emit_decl_init(vector<NodePtr>& init_list, int offset, int total
             emit_local_save(init->type, offset + init->offset);
         }
     }
-    emit_zero(offset + last_end, offset + total_size);
+    emit_block_zero("rbp", offset + last_end, total_size - last_end);
 }
 
 void Generator::emit_lvar_init(NodePtr node) {
@@ -376,7 +467,7 @@ void Generator::emit_addr(NodePtr node) {
     case NK_LOCAL_VAR: {
         shared_ptr<LocalVarNode> lvar = dynamic_pointer_cast<LocalVarNode>(node);
         emit_lvar_init(lvar);
-        emit("lea ?(%rbp), %rax", lvar->offset);
+        emit("lea ?, %rax", local_addr(lvar->offset));
         return;
     }
     case NK_GLOBAL_VAR: {
@@ -529,28 +620,283 @@ void Generator::emit_save(NodePtr node) {
     }
 }
 
+// value as an object of the integer type
+static long long wrap_to_type(Type* type, long long value) {
+    if(type->kind == TK_BOOL)
+        return value != 0;
+    switch(type->size) {
+    case 1: return type->is_unsigned ? (long long)(uint8_t)value : (long long)(int8_t)value;
+    case 2: return type->is_unsigned ? (long long)(uint16_t)value : (long long)(int16_t)value;
+    case 4: return type->is_unsigned ? (long long)(uint32_t)value : (long long)(int32_t)value;
+    default: return value;
+    }
+}
+
+// Literals that fit in an imm32 and int/pointer locals of the given size can be
+// used as the source operand of an instruction without going through a register.
+char* Generator::get_int_operand(NodePtr node, int size) {
+    Type* to = node->type;
+    if(node->kind == NK_CONV && node->type->is_int_type()) {
+        NodePtr operand = dynamic_pointer_cast<UnaryOperNode>(node)->operand;
+        if(operand->kind == NK_LITERAL || 
+          (operand->kind == NK_LOCAL_VAR && operand->type->size == node->type->size))
+            node = operand;
+    }
+    if(node->kind == NK_LITERAL) {
+        shared_ptr<IntNode> literal = dynamic_pointer_cast<IntNode>(node);
+        if(literal == nullptr || !literal->type->is_int_type() || !to->is_int_type()) 
+            return nullptr;
+        // the conversion may change the value, e.g. (unsigned)-1
+        long long value = wrap_to_type(to, wrap_to_type(literal->type, literal->value));
+        if(value < INT32_MIN || value > INT32_MAX) 
+            return nullptr;
+        return format("$%lld", value);
+    }
+    if(node->kind == NK_LOCAL_VAR) {
+        shared_ptr<LocalVarNode> lvar = dynamic_pointer_cast<LocalVarNode>(node);
+        Type* type = lvar->type;
+        if(!lvar->init_list.empty() || type->bitsize > 0 || type->size != size)
+            return nullptr;
+        if(!type->is_int_type() && type->kind != TK_PTR)
+            return nullptr;
+        return local_addr(lvar->offset);
+    }
+    return nullptr;
+}
+
+// rax = rax op operand, where operand comes from get_int_operand()
+void Generator::emit_int_operand_op(const char* inst, char* operand, Type* type) {
+    if(operand[0] == '$' || type->size == 8) {
+        emit("? ?, %rax", inst, operand);
+    }
+    else {
+        emit("? ?, %eax", inst, operand);
+        if(!type->is_unsigned)
+            emit("movslq %eax, %rax");
+    }
+}
+
+static inline int log2_exact(uint64_t value) {
+    return (value && !(value & (value - 1))) ? __builtin_ctzll(value) : -1;
+}
+
+static inline int log2_ceil(uint64_t value) {
+    return (value <= 1) ? 0 : 64 - __builtin_clzll(value - 1);
+}
+
+// "ax", 4 -> "eax"; "ax", 8 -> "rax"
+static inline char* sized_reg(const char* reg, int size) {
+    return format("%c%s", (size == 8) ? 'r' : 'e', reg);
+}
+
+// rax = rax * value, using shifts and lea where possible
+void Generator::emit_mul_imm(int64_t value) {
+    int shift = log2_exact(value < 0 ? -(uint64_t)value : value);
+    if(value == 0) {
+        emit("xor %eax, %eax");
+    }
+    else if(shift >= 0) {
+        if(shift > 0)
+            emit("sal $?, %rax", shift);
+        if(value < 0)
+            emit("neg %rax");
+    }
+    else if(value % 9 == 0 && log2_exact(value / 9) >= 0) {
+        emit("lea (%rax,%rax,8), %rax");
+        emit_mul_imm(value / 9);
+    }
+    else if(value % 5 == 0 && log2_exact(value / 5) >= 0) {
+        emit("lea (%rax,%rax,4), %rax");
+        emit_mul_imm(value / 5);
+    }
+    else if(value % 3 == 0 && log2_exact(value / 3) >= 0) {
+        emit("lea (%rax,%rax,2), %rax");
+        emit_mul_imm(value / 3);
+    }
+    else if(value >= INT32_MIN && value <= INT32_MAX) {
+        emit("imul $?, %rax", value);
+    }
+    else {
+        emit("movq $?, %rcx", value);
+        emit("imul %rcx, %rax");
+    }
+}
+
+// rax = rax / value or rax % value for an integer type of 4 or 8 bytes, without div.
+// Divisors that are not powers of two use multiplication by a magic number, see
+// T. Granlund and P. Montgomery, "Division by Invariant Integers using Multiplication".
+// Return false if the divisor is 0 and the division must happen at run time.
+bool Generator::emit_divmod_imm(int op, int64_t value, Type* type) {
+    int size = type->size, bits = size * 8;
+    char *ax = sized_reg("ax", size), *cx = sized_reg("cx", size), *dx = sized_reg("dx", size);
+    uint64_t mask = (size == 8) ? ~0ULL : 0xFFFFFFFFULL;
+    bool is_mod = (op == '%');
+
+    // rax = rcx - rax * divisor
+    auto emit_remainder = [&](uint64_t divisor) {
+        if((int64_t)divisor >= INT32_MIN && (int64_t)divisor <= INT32_MAX) {
+            emit("imul $?, %?", (int64_t)divisor, ax);
+        }
+        else {
+            emit("movq $?, %rdx", divisor);
+            emit("imul %?, %?", dx, ax);
+        }
+        emit("sub %?, %?", ax, cx);
+        emit("mov %?, %?", cx, ax);
+    };
+
+    if(type->is_unsigned) {
+        uint64_t d = (uint64_t)value & mask;
+        int shift = log2_exact(d);
+        if(d == 0) 
+            return false;
+        if(size == 4)
+            emit("movl %eax, %eax");
+        if(shift == 0) {
+            if(is_mod) 
+                emit("xor %eax, %eax");
+        }
+        else if(shift > 0) {
+            if(!is_mod) {
+                emit("shr $?, %?", shift, ax);
+            }
+            else if(d - 1 <= INT32_MAX) {
+                emit("and $?, %?", d - 1, ax);
+            }
+            else {
+                emit("movq $?, %rcx", d - 1);
+                emit("and %rcx, %rax");
+            }
+        }
+        else {
+            // t = MULUH(m, n); q = (t + ((n - t) >> 1)) >> (l - 1)
+            int l = log2_ceil(d);
+            unsigned __int128 one = 1;
+            uint64_t m = (uint64_t)(((one << bits) * ((one << l) - d)) / d + 1);
+            emit("movq %rax, %rcx");
+            if(size == 8) {
+                emit("movq $?, %rdx", m);
+                emit("mulq %rdx");
+            }
+            else {
+                emit("movl $?, %edx", m);
+                emit("imulq %rcx, %rdx");
+                emit("shrq $32, %rdx");
+            }
+            emit("mov %?, %?", cx, ax);
+            emit("sub %?, %?", dx, ax);
+            emit("shr $1, %?", ax);
+            emit("add %?, %?", dx, ax);
+            if(l > 1)
+                emit("shr $?, %?", l - 1, ax);
+            if(is_mod)
+                emit_remainder(d);
+        }
+        return true;
+    }
+
+    int64_t d = (size == 8) ? value : (int32_t)value;
+    uint64_t ad = (d < 0) ? -(uint64_t)d : d;
+    int shift = log2_exact(ad);
+    if(d == 0) 
+        return false;
+    if(shift == 0) {
+        if(is_mod) 
+            emit("xor %eax, %eax");
+        else if(d < 0)
+            emit("neg %?", ax);
+    }
+    else if(shift > 0) {
+        // Round towards zero by adding 2^shift - 1 to negative dividends
+        emit("mov %?, %?", ax, dx);
+        emit("sar $?, %?", bits - 1, dx);
+        emit("shr $?, %?", bits - shift, dx);
+        if(!is_mod) {
+            emit("add %?, %?", dx, ax);
+            emit("sar $?, %?", shift, ax);
+            if(d < 0)
+                emit("neg %?", ax);
+        }
+        else {
+            emit("mov %?, %?", ax, cx);
+            emit("add %?, %?", dx, cx);
+            emit("and $?, %?", -(int64_t)ad, cx);
+            emit("sub %?, %?", cx, ax);
+        }
+    }
+    else {
+        // q = (n + MULSH(m - 2^N, n)) >> (l - 1) - XSIGN(n), negated if d < 0
+        int l = log2_ceil(ad);
+        unsigned __int128 one = 1;
+        int64_t m = (int64_t)(uint64_t)(1 + (one << (bits + l - 1)) / ad - (one << bits));
+        if(size == 8) {
+            emit("movq %rax, %rcx");
+            emit("movq $?, %rdx", m);
+            emit("imulq %rdx");
+        }
+        else {
+            emit("movslq %eax, %rcx");
+            emit("movq $?, %rdx", m);
+            emit("imulq %rcx, %rdx");
+            emit("sarq $32, %rdx");
+        }
+        emit("lea (%rdx,%rcx), %?", ax);
+        if(l > 1)
+            emit("sar $?, %?", l - 1, ax);
+        emit("mov %?, %?", cx, dx);
+        emit("sar $?, %?", bits - 1, dx);
+        emit("sub %?, %?", dx, ax);
+        if(d < 0)
+            emit("neg %?", ax);
+        if(is_mod)
+            emit_remainder(d);
+    }
+    if(size == 4)
+        emit("movslq %eax, %rax");
+    return true;
+}
+
 void Generator::emit_binop_cmp(NodePtr node) {
     shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node); 
     if(expr->left->type->is_float_type()) {
+        const char* inst = (expr->left->type->kind == TK_FLOAT) ? "ucomiss" : "ucomisd";
         expr->left->codegen(*this);
-        push_xmm(0);
-        expr->right->codegen(*this);
-        pop_xmm(1);
-        if(expr->left->type->kind == TK_FLOAT) 
-            emit("ucomiss %xmm0, %xmm1");
-        else
-            emit("ucomisd %xmm0, %xmm1");
+        char* operand = get_float_operand(expr->right, expr->left->type);
+        if(operand) {
+            emit("? ?, %xmm0", inst, operand);
+        }
+        else {
+            int reg = save_xmm0(expr->right);
+            expr->right->codegen(*this);
+            if(reg < 0) {
+                pop_xmm(1);
+                emit("? %xmm0, %xmm1", inst);
+            }
+            else {
+                emit("? %xmm0, %xmm?", inst, reg);
+                --xmm_depth;
+            }
+        }
     }
     else {
+        bool is_quad = (expr->left->type->size == 8);
         expr->left->codegen(*this);
-        push("rax");
-        expr->right->codegen(*this);
-        pop("rcx");
-        int kind = expr->left->type->kind;
-        if(kind == TK_LONG || kind == TK_LONG_LONG) 
-            emit("cmp %rax, %rcx");
-        else
-            emit("cmp %eax, %ecx");
+        char* operand = get_int_operand(expr->right, expr->left->type->size);
+        if(operand && !strcmp(operand, "$0")) {
+            emit("test %?, %?", is_quad ? "rax" : "eax", is_quad ? "rax" : "eax");
+        }
+        else if(operand) {
+            emit("cmp ?, %?", operand, is_quad ? "rax" : "eax");
+        }
+        else {
+            push("rax");
+            expr->right->codegen(*this);
+            pop("rcx");
+            if(is_quad) 
+                emit("cmp %rax, %rcx");
+            else
+                emit("cmp %eax, %ecx");
+        }
     }
 
     const char* inst;
@@ -580,12 +926,50 @@ void Generator::emit_binop_int_arith(NodePtr node) {
     default: error("invalid binary integer arithmetic operator %s", op2s(node->kind));    
     }
     shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node); 
+    bool is_div = (expr->kind == '/' || expr->kind == '%');
+    bool is_shift = (expr->kind == NK_SAL || expr->kind == NK_SAR || expr->kind == NK_SHR);
+
+    // Multiplication is commutative, so a literal can also be on the left
+    char* left_operand = (expr->kind == '*') ? get_int_operand(expr->left, expr->type->size) : nullptr;
+    if(left_operand && left_operand[0] == '$') {
+        expr->right->codegen(*this);
+        emit_mul_imm(atoll(left_operand + 1));
+        return;
+    }
     expr->left->codegen(*this);
-    push("rax");
-    expr->right->codegen(*this);
-    emit("movq %rax, %rcx");
-    pop("rax");
-    if(expr->kind == '/' || expr->kind == '%') {
+
+    // The right operand is a literal or a local variable: use it directly as the source operand
+    char* operand = get_int_operand(expr->right, expr->type->size);
+    if(operand && operand[0] == '$' && expr->kind == '*') {
+        emit_mul_imm(atoll(operand + 1));
+        return;
+    }
+    if(operand && operand[0] == '$' && is_div) {
+        if(emit_divmod_imm(expr->kind, atoll(operand + 1), expr->type))
+            return;
+    }
+    if(operand && is_shift) {
+        long long count = (operand[0] == '$') ? atoll(operand + 1) : -1;
+        if(count >= 0 && count < 64) {
+            emit("? $?, %?", inst, count, get_reg(expr->left->type, 'a'));
+            return;
+        }
+    }
+    else if(operand && !is_div) {
+        emit_int_operand_op(inst, operand, expr->type);
+        return;
+    }
+
+    if(operand && (operand[0] == '$' || expr->type->size == 8)) {
+        emit("movq ?, %rcx", operand);
+    }
+    else {
+        push("rax");
+        expr->right->codegen(*this);
+        emit("movq %rax, %rcx");
+        pop("rax");
+    }
+    if(is_div) {
         if(expr->type->is_unsigned) {
             emit("movl $0, %edx");
             emit("divq %rcx");
@@ -598,7 +982,7 @@ void Generator::emit_binop_int_arith(NodePtr node) {
             emit("movq %rdx, %rax");
         }
     }
-    else if(expr->kind == NK_SAL || expr->kind == NK_SAR || expr->kind == NK_SHR) {
+    else if(is_shift) {
         emit("? %cl, %?", inst, get_reg(expr->left->type, 'a'));
     }
     else {
@@ -619,25 +1003,102 @@ void Generator::emit_binop_float_arith(NodePtr node) {
     }
     shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node); 
     expr->left->codegen(*this);
-    push_xmm(0);
+    char* operand = get_float_operand(expr->right, node->type);
+    if(operand) {
+        emit("? ?, %xmm0", inst, operand);
+        return;
+    }
+    int reg = save_xmm0(expr->right);
     expr->right->codegen(*this);
-    emit("? %xmm0, %xmm1", (is_double ? "movsd" : "movss"));    
-    pop_xmm(0);
-    emit("? %xmm1, %xmm0", inst);
+    if(reg < 0) {
+        emit("? %xmm0, %xmm1", (is_double ? "movsd" : "movss"));    
+        pop_xmm(0);
+        emit("? %xmm1, %xmm0", inst);
+    }
+    else if(node->kind == '+' || node->kind == '*') {
+        emit("? %xmm?, %xmm0", inst, reg);
+        --xmm_depth;
+    }
+    else {
+        emit("? %xmm0, %xmm?", inst, reg);
+        emit("movaps %xmm?, %xmm0", reg);
+        --xmm_depth;
+    }
+}
+
+static bool contains_call(NodePtr node) {
+    if(node->kind == NK_FUNC_CALL || node->kind == NK_FUNCPTR_CALL)
+        return true;
+    bool found = false;
+    for_each_child(node, [&](NodePtr& child) { found = found || contains_call(child); });
+    return found;
+}
+
+// Keep xmm0 in one of xmm8-xmm14 while node is evaluated, they are not used 
+// otherwise and only calls clobber them. Returns -1 when xmm0 is pushed instead.
+int Generator::save_xmm0(NodePtr node) {
+    if(xmm_depth >= 7 || contains_call(node)) {
+        push_xmm(0);
+        return -1;
+    }
+    int reg = 8 + xmm_depth++;
+    emit("movaps %xmm0, %xmm?", reg);
+    return reg;
+}
+
+// Memory operand for a float of the given type that needs no code to evaluate
+char* Generator::get_float_operand(NodePtr node, Type* type) {
+    if(node->type->kind != type->kind)
+        return nullptr;
+    switch(node->kind) {
+    case NK_LITERAL:
+        return format("%s(%%rip)", get_float_const(type, dynamic_pointer_cast<FloatNode>(node)->value));
+    case NK_LOCAL_VAR: {
+        shared_ptr<LocalVarNode> lvar = dynamic_pointer_cast<LocalVarNode>(node);
+        return lvar->init_list.empty() ? local_addr(lvar->offset) : nullptr;
+    }
+    case NK_GLOBAL_VAR: 
+        return format("%s(%%rip)", dynamic_pointer_cast<GlobalVarNode>(node)->global_label);
+    default:
+        return nullptr;
+    }
+}
+
+// Float literals are pooled by value and emitted at the end of the file
+char* Generator::get_float_const(Type* type, double value) {
+    uint64_t bits;
+    if(type->kind == TK_FLOAT) {
+        float f = value;
+        bits = *(uint32_t*)&f;
+    }
+    else {
+        bits = *(uint64_t*)&value;
+    }
+    auto key = make_pair(type->size, bits);
+    auto iter = float_consts.find(key);
+    if(iter != float_consts.end())
+        return iter->second;
+    return float_consts[key] = make_label();
+}
+
+void Generator::emit_float_consts() {
+    if(float_consts.empty()) 
+        return;
+    emit_noindent(".section .rodata");
+    for(auto& item:float_consts) {
+        emit_noindent(".align ?", item.first.first);
+        emit_label(item.second);
+        emit("? ?", item.first.first == 4 ? ".long" : ".quad", item.first.second);
+    }
 }
 
 void Generator::emit_copy_struct(NodePtr from, NodePtr to) {
-    int aligned_size = align8(from->type->size);
     push("rcx");
     push("r11");
     emit_addr(from);
     emit("movq %rax, %rcx");
     emit_addr(to);
-    int i = 0;
-    for(; i < aligned_size; i += 8) {
-        emit("movq ?(%rcx), %r11", i);
-        emit("movq %r11, ?(%rax)", i);
-    }
+    emit_block_copy("rcx", "rax", from->type->size);
     pop("r11");
     pop("rcx");
 }
@@ -669,14 +1130,14 @@ void Generator::emit_data_primtype(Type* type, NodePtr val, int subsection) {
         return;
     }
     case TK_FLOAT: {
-        double v = val->eval_float();
-        emit(".long %d", *(uint32_t *)&v);
+        float v = val->eval_float();
+        emit(".long ?", *(uint32_t *)&v);
         return;
     }
     case TK_DOUBLE:
     case TK_LONG_DOUBLE: {
         double v = val->eval_float();
-        emit(".quad %d", *(uint64_t *)&v);
+        emit(".quad ?", *(uint64_t *)&v);
         return;
     }
     case TK_PTR: {
@@ -864,7 +1325,7 @@ void Generator::emit_builtin_va_start(NodePtr node) {
     push("rcx");
     emit("movl $?, (%rax)", ftype->numgp * 8);
     emit("movl $?, 4(%rax)", 48 + ftype->numfp * 16);
-    emit("lea ?(%rbp), %rcx", -REG_SAVE_AREA_SIZE);
+    emit("lea ?, %rcx", local_addr(-REG_SAVE_AREA_SIZE));
     emit("mov %rcx, 16(%rax)");
     pop("rcx");
 }
@@ -915,32 +1376,24 @@ void IntNode::codegen(Generator& gen) {
 
 void FloatNode::codegen(Generator& gen) {
     SAVE_CURRENT_POS;
-    if(!label) {
-        label = make_label();
-        gen.emit_noindent(".data");
-        gen.emit_label(label);
-        if(type->kind == TK_FLOAT) {
-            gen.emit(".long ?", *(uint32_t*)&value);
-        }
-        else {
-            gen.emit(".quad ?", *(uint64_t*)&value);
-        }
-        gen.emit_noindent(".text");
-    }
     if(type->kind == TK_FLOAT) {
-        gen.emit("movss ?(%rip), %xmm0", label);
+        gen.emit("movss ?(%rip), %xmm0", gen.get_float_const(type, value));
     }
     else {
-        gen.emit("movsd ?(%rip), %xmm0", label);
+        gen.emit("movsd ?(%rip), %xmm0", gen.get_float_const(type, value));
     }
 }
 
 void StringNode::codegen(Generator& gen) {
     SAVE_CURRENT_POS;
-    if(!label) {
-        label = make_label();
+    // functions generated in parallel each emit their own copy
+    char* l = gen.parallel ? nullptr : label;
+    if(!l) {
+        l = make_label();
+        // a tentatively generated function may be discarded with its data
+        if(!gen.tentative && !gen.parallel) label = l;
         gen.emit_noindent(".data");
-        gen.emit_label(label);
+        gen.emit_label(l);
         if(strlen(value) == 0) {
             gen.emit(".string \"\"");
         }
@@ -950,7 +1403,7 @@ void StringNode::codegen(Generator& gen) {
         }
         gen.emit_noindent(".text");
     }
-    gen.emit("lea ?(%rip), %rax", label);
+    gen.emit("lea ?(%rip), %rax", l);
 }
 
 void LocalVarNode::codegen(Generator& gen) {
@@ -1053,6 +1506,11 @@ void BinaryOperNode::codegen(Generator& gen) {
     }
     case '&': case '|': {
         left->codegen(gen);
+        char* operand = gen.get_int_operand(right, type->size);
+        if(operand) {
+            gen.emit_int_operand_op(kind == '&' ? "and" : "or", operand, type);
+            return;
+        }
         gen.push("rax");
         right->codegen(gen);
         gen.pop("rcx");
@@ -1088,7 +1546,9 @@ void BinaryOperNode::codegen(Generator& gen) {
         return;
     }
     case '=': {
-        if(left->type->kind == TK_STRUCT && left->type->size > 8) {
+        int size = left->type->size;
+        if((left->type->kind == TK_STRUCT || left->type->kind == TK_UNION) 
+            && (size > 8 || (size & (size - 1)))) {
             gen.emit_copy_struct(right, left);
         }
         else {
@@ -1106,13 +1566,25 @@ void BinaryOperNode::codegen(Generator& gen) {
     default: {
         if(type->kind == TK_PTR) {
             assert(left->type->kind == TK_PTR);
+            if(kind != '+' && kind != '-') 
+                error("invalid pointer operator %s", op2s(kind));
+            int size = dynamic_cast<PtrType*>(left->type)->ptr_type->size;
             left->codegen(gen);
+            char* operand = gen.get_int_operand(right, right->type->size);
+            if(operand && operand[0] == '$') {
+                long long offset = atoll(operand + 1) * max(size, 1);
+                if(offset >= INT32_MIN && offset <= INT32_MAX) {
+                    gen.emit("? $?, %rax", kind == '+' ? "add" : "sub", offset);
+                    return;
+                }
+            }
             gen.push("rcx");
             gen.push("rax");
             right->codegen(gen);
-            int size = dynamic_cast<PtrType*>(left->type)->ptr_type->size;
+            // casts leave rax extended from the operand type
+            gen.emit_int_to_int64(right->type);
             if(size > 1)
-                gen.emit("imul $?, %rax", size);
+                gen.emit_mul_imm(size);
             gen.emit("movq %rax, %rcx");
             gen.pop("rax");
             switch(kind) {
@@ -1124,6 +1596,12 @@ void BinaryOperNode::codegen(Generator& gen) {
         }
         else if(type->is_int_type()) {
             gen.emit_binop_int_arith(shared_from_this());
+            // C11 6.5.6p9: the difference of two pointers is in units of the element size
+            if(kind == '-' && left->type->kind == TK_PTR) {
+                int size = dynamic_cast<PtrType*>(left->type)->ptr_type->size;
+                if(size > 1)
+                    gen.emit_divmod_imm('/', size, type);
+            }
         }
         else if(type->is_float_type()) {
             gen.emit_binop_float_arith(shared_from_this());
@@ -1138,8 +1616,17 @@ void BinaryOperNode::codegen(Generator& gen) {
 void TernaryOperNode::codegen(Generator& gen) {
     SAVE_CURRENT_POS;
     cond->codegen(gen);
-    char* not_equal = make_label();
     gen.emit("test %rax, %rax");
+    // a branch whose only statement is a jump becomes the conditional jump itself
+    if(!then && els && els->kind == NK_JUMP) {
+        gen.emit("je ?", dynamic_pointer_cast<JumpNode>(els)->normal_label);
+        return;
+    }
+    if(then && !els && then->kind == NK_JUMP) {
+        gen.emit("jne ?", dynamic_pointer_cast<JumpNode>(then)->normal_label);
+        return;
+    }
+    char* not_equal = make_label();
     gen.emit("je ?", not_equal);
     if(then) {
         then->codegen(gen);
@@ -1166,6 +1653,30 @@ The calling convention used by X86-64 on Linux is somewhat different and is know
 5.The called function may use any registers, but it must restore the values of the registers %rbx, %rbp, %rsp, and %r12-%r15, if it changes them.
 6.The return value of the function is placed in %eax.
 */
+// Whether the argument can be evaluated after the argument registers are loaded:
+// it must not call and may only use rax, xmm0 and r11
+static bool is_simple_arg(NodePtr node) {
+    switch(node->kind) {
+    case NK_LITERAL: 
+    case NK_GLOBAL_VAR: 
+    case NK_FUNC_DESG:
+        return true;
+    case NK_LOCAL_VAR:
+        return dynamic_pointer_cast<LocalVarNode>(node)->init_list.empty();
+    case NK_STRUCT_MEMBER: {
+        NodePtr struc = dynamic_pointer_cast<StructMemberNode>(node)->struc;
+        return node->type->kind != TK_STRUCT && is_simple_arg(struc);
+    }
+    case NK_ADDR: 
+    case NK_DEREF:
+    case NK_CAST:
+    case NK_CONV:
+        return is_simple_arg(dynamic_pointer_cast<UnaryOperNode>(node)->operand);
+    default:
+        return false;
+    }
+}
+
 void FuncCallNode::codegen(Generator& gen) {
     SAVE_CURRENT_POS;
     // If it is a built-in function, execute it directly
@@ -1178,6 +1689,7 @@ void FuncCallNode::codegen(Generator& gen) {
         return;
     }
 
+    gen.has_call = true;
     int stack_size_dup = gen.stack_size;
     bool is_ptr_func_call = (func_ptr != nullptr);
 
@@ -1197,22 +1709,19 @@ void FuncCallNode::codegen(Generator& gen) {
         }
     }
 
-    // save register
-    for(int i = 0; i < int_args.size(); ++i) {
-        gen.push(REGS[i]);
-    }
-    for(int i = 1; i < float_args.size(); ++i) {
-        gen.push_xmm(i);
+    // rsp must be 16-byte aligned at the call
+    int others_size = 0;
+    for(auto arg:other_args) {
+        others_size += align8(arg->type->size);
     }
-
-    bool padding = gen.stack_size % 16;
+    bool padding = !is_tail_call && (gen.stack_size + others_size) % 16;
     if(padding) {
         gen.emit("sub $8, %rsp");
         gen.stack_size += 8;
     }
     
     // emit args
-    int others_size = 0;
+    others_size = 0;
     for(int i = other_args.size() - 1; i >= 0; --i) {
         Type* type = other_args[i]->type;
         if(type->kind == TK_STRUCT) {
@@ -1231,42 +1740,67 @@ void FuncCallNode::codegen(Generator& gen) {
         }
     }
 
-    // The following commented code is wrong; rdx, rcx may be changed.
-    // for(int i = 0; i < float_args.size(); ++i) {
-    //     float_args[i]->codegen(gen);
-    //     if(i == 0) {
-    //         gen.push_xmm(0);
-    //     }
-    //     else {
-    //         gen.emit("movaps %xmm0, %xmm?", i);
-    //     }
-    // }
-    // if(float_args.size() > 0) gen.pop_xmm(0);
-
-    // for(int i = 0; i < int_args.size(); ++i) {
-    //     int_args[i]->codegen(gen);
-    //     gen.emit("movq %rax, %?", REGS[i]);
-    // }
-
+    // Arguments that may call or use scratch registers are evaluated first 
+    // and kept on the stack, the others go straight into their registers.
+    // Nothing is live in the argument registers across the evaluation.
+    bool simple_func_ptr = !is_ptr_func_call || is_simple_arg(func_ptr);
+    if(!simple_func_ptr) {
+        func_ptr->codegen(gen);
+        gen.push("rax");
+    }
     for(int i = 0; i < float_args.size(); ++i) {
-        float_args[i]->codegen(gen);
-        gen.push_xmm(0);
+        if(!is_simple_arg(float_args[i])) {
+            float_args[i]->codegen(gen);
+            gen.push_xmm(0);
+        }
     }
-    for(int i = 0; i < int_args.size(); ++i) {
-        int_args[i]->codegen(gen);
-        gen.push("rax");
+    // the last one needs no stack
+    int last = int_args.size() - 1;
+    while(last >= 0 && is_simple_arg(int_args[last])) --last;
+    for(int i = 0; i <= last; ++i) {
+        if(!is_simple_arg(int_args[i])) {
+            int_args[i]->codegen(gen);
+            if(i == last)
+                gen.emit("movq %rax, %?", REGS[i]);
+            else
+                gen.push("rax");
+        }
+    }
+    for(int i = last - 1; i >= 0; --i) {
+        if(!is_simple_arg(int_args[i])) 
+            gen.pop(REGS[i]);
     }
 
-    for(int i = int_args.size() - 1; i >= 0; --i) {
-        gen.pop(REGS[i]);
+    // integer conversions may clobber xmm0, so the floats come last
+    for(size_t i = 0; i < int_args.size(); ++i) {
+        if(!is_simple_arg(int_args[i])) 
+            continue;
+        if(int_args[i]->kind == NK_LITERAL && int_args[i]->type->is_int_type()) {
+            gen.emit("movq $?, %?", (uint64_t)int_args[i]->eval_int(), REGS[i]);
+        }
+        else {
+            int_args[i]->codegen(gen);
+            gen.emit("movq %rax, %?", REGS[i]);
+        }
+    }
+    for(int i = float_args.size() - 1; i >= 0; --i) {
+        if(!is_simple_arg(float_args[i])) 
+            continue;
+        float_args[i]->codegen(gen);
+        if(i > 0) 
+            gen.emit("movaps %xmm0, %xmm?", i);
     }
     for(int i = float_args.size() - 1; i >= 0; --i) {
-        gen.pop_xmm(i);
+        if(!is_simple_arg(float_args[i])) 
+            gen.pop_xmm(i);
     }
 
     // func call
     if(is_ptr_func_call) {
-        func_ptr->codegen(gen);
+        if(simple_func_ptr)
+            func_ptr->codegen(gen);
+        else 
+            gen.pop("rax");
         gen.emit("movq %rax, %r11");
     }
 
@@ -1274,6 +1808,11 @@ void FuncCallNode::codegen(Generator& gen) {
         gen.emit("mov $?, %eax", (unsigned int)(float_args.size()));
     }
 
+    if(is_tail_call) {
+        gen.emit_epilogue(is_ptr_func_call ? "*%r11" : func_name);
+        gen.stack_size = stack_size_dup;
+        return;
+    }
     if(is_ptr_func_call) {
         gen.emit("call *%r11");
     }
@@ -1285,7 +1824,6 @@ void FuncCallNode::codegen(Generator& gen) {
         gen.emit("movzx %al, %rax");
     }
 
-    // restore registers
     if(others_size > 0) {
         gen.emit("add $?, %rsp", others_size);
         gen.stack_size -= others_size;
@@ -1294,12 +1832,6 @@ void FuncCallNode::codegen(Generator& gen) {
         gen.emit("add $8, %rsp");
         gen.stack_size -= 8;
     }
-    for(int i = float_args.size() - 1; i > 0; --i) {
-        gen.pop_xmm(i);
-    }
-    for(int i = int_args.size() - 1; i >= 0; --i) {
-        gen.pop(REGS[i]);
-    }
 
     assert(stack_size_dup == gen.stack_size);
 }
@@ -1338,8 +1870,17 @@ void CompoundStmtNode::codegen(Generator& gen) {
 void IfNode::codegen(Generator& gen) {
     SAVE_CURRENT_POS;
     cond->codegen(gen);
-    char* not_equal = make_label();
     gen.emit("test %rax, %rax");
+    // a branch whose only statement is a jump becomes the conditional jump itself
+    if(!then && els && els->kind == NK_JUMP) {
+        gen.emit("je ?", dynamic_pointer_cast<JumpNode>(els)->normal_label);
+        return;
+    }
+    if(then && !els && then->kind == NK_JUMP) {
+        gen.emit("jne ?", dynamic_pointer_cast<JumpNode>(then)->normal_label);
+        return;
+    }
+    char* not_equal = make_label();
     gen.emit("je ?", not_equal);
     if(then) {
         then->codegen(gen);
@@ -1368,26 +1909,226 @@ void JumpNode::codegen(Generator& gen) {
     gen.emit("jmp ?", normal_label);
 }
 
+// The table holds label offsets relative to itself, so it stays position independent
+void JumpTableNode::codegen(Generator& gen) {
+    SAVE_CURRENT_POS;
+    char* table = make_label();
+    var->codegen(gen);
+    if(min != 0)
+        gen.emit("sub $?, %rax", min);
+    gen.emit("cmp $?, %rax", labels.size() - 1);
+    gen.emit("ja ?", default_label);
+    gen.emit("lea ?(%rip), %rcx", table);
+    gen.emit("movslq (%rcx,%rax,4), %rax");
+    gen.emit("add %rcx, %rax");
+    gen.emit("jmp *%rax");
+    gen.emit_noindent(".section .rodata");
+    gen.emit_noindent(".align 4");
+    gen.emit_label(table);
+    for(auto label:labels) {
+        gen.emit(".long ?-?", label, table);
+    }
+    gen.emit_noindent(".text");
+}
+
+// registers of the array bases of a vector loop, the stored one first
+static char* VEC_REGS[6] = {"rdx", "rsi", "rdi", "r8", "r9", "r10"};
+
+static const char* vec_mov_inst(Type* type) {
+    switch(type->kind) {
+    case TK_FLOAT: return "movups";
+    case TK_DOUBLE: return "movupd";
+    default: return "movdqu";
+    }
+}
+
+static const char* vec_op_inst(Type* type, int op) {
+    if(type->is_float_type()) {
+        const char* suffix = type->kind == TK_FLOAT ? "ps" : "pd";
+        switch(op) {
+        case '+': return format("add%s", suffix);
+        case '-': return format("sub%s", suffix);
+        case '*': return format("mul%s", suffix);
+        case '/': return format("div%s", suffix);
+        }
+    }
+    else {
+        const char* suffix = type->size == 1 ? "b" : type->size == 2 ? "w" : type->size == 4 ? "d" : "q";
+        switch(op) {
+        case '+': return format("padd%s", suffix);
+        case '-': return format("psub%s", suffix);
+        case '*': if(type->size == 2) return "pmullw"; break;
+        case '&': return "pand";
+        case '|': return "por";
+        case '^': return "pxor";
+        }
+    }
+    error("invalid vector operator %s", op2s(op));
+    return nullptr;
+}
+
+// xmm<dst> = xmm<dst> op xmm<src>
+static void emit_vec_op(Generator& gen, Type* type, int op, int dst, int src) {
+    if(op == '*' && type->is_int_type() && type->size == 4) {
+        // SSE2 has no pmulld: multiply the even and the odd lanes into 64 bits, 
+        // then gather the low halves
+        gen.emit("movdqa %xmm?, %xmm6", dst);
+        gen.emit("pmuludq %xmm?, %xmm?", src, dst);
+        gen.emit("psrlq $32, %xmm6");
+        gen.emit("movdqa %xmm?, %xmm7", src);
+        gen.emit("psrlq $32, %xmm7");
+        gen.emit("pmuludq %xmm7, %xmm6");
+        gen.emit("pshufd $8, %xmm?, %xmm?", dst, dst);
+        gen.emit("pshufd $8, %xmm6, %xmm6");
+        gen.emit("punpckldq %xmm6, %xmm?", dst);
+        return;
+    }
+    gen.emit("? %xmm?, %xmm?", vec_op_inst(type, op), src, dst);
+}
+
+// Copy the scalar on top of the stack to all lanes of xmm<id>
+static void emit_vec_broadcast(Generator& gen, Type* type, int id) {
+    if(type->is_float_type()) {
+        gen.pop_xmm(id);
+        if(type->kind == TK_FLOAT)
+            gen.emit("shufps $0, %xmm?, %xmm?", id, id);
+        else
+            gen.emit("unpcklpd %xmm?, %xmm?", id, id);
+        return;
+    }
+    gen.pop("r11");
+    gen.emit("movq %r11, %xmm?", id);
+    switch(type->size) {
+    case 1: 
+        gen.emit("punpcklbw %xmm?, %xmm?", id, id);
+        // fall through
+    case 2: 
+        gen.emit("punpcklwd %xmm?, %xmm?", id, id);
+        // fall through
+    case 4: 
+        gen.emit("pshufd $0, %xmm?, %xmm?", id, id);
+        break;
+    default:
+        gen.emit("punpcklqdq %xmm?, %xmm?", id, id);
+    }
+}
+
+// The code is evaluated on xmm0-xmm5 with the scalars in xmm8-xmm13 
+// and the sum of a reduction in xmm14. When xmm8-xmm14 hold float temporaries 
+// of an enclosing expression, the scalar loop does all the iterations instead.
+void VectorLoopNode::codegen(Generator& gen) {
+    SAVE_CURRENT_POS;
+    if(gen.xmm_depth > 0)
+        return;
+    int size = elem_type->size, lanes = 16 / size;
+    const char* mov = vec_mov_inst(elem_type);
+    vector<NodePtr> bases = arrays;
+    if(dst)
+        bases.insert(bases.begin(), dst);
+
+    var->codegen(gen);
+    gen.push("rax");
+    bound->codegen(gen);
+    gen.push("rax");
+    for(auto base:bases) {
+        base->codegen(gen);
+        gen.push("rax");
+    }
+    for(auto scalar:scalars) {
+        scalar->codegen(gen);
+        if(elem_type->is_float_type())
+            gen.push_xmm(0);
+        else
+            gen.push("rax");
+    }
+    for(int i = scalars.size() - 1; i >= 0; --i)
+        emit_vec_broadcast(gen, elem_type, 8 + i);
+    for(int i = bases.size() - 1; i >= 0; --i)
+        gen.pop(VEC_REGS[i]);
+    gen.pop("rcx");
+    gen.pop("rax");
+
+    // dst may not start inside the 16 bytes read ahead from a loaded array
+    char* skip = make_label();
+    if(dst && check_alias) {
+        for(size_t i = 1; i < bases.size(); ++i) {
+            gen.emit("lea -1(%rdx), %r11");
+            gen.emit("sub %?, %r11", VEC_REGS[i]);
+            gen.emit("cmp $15, %r11");
+            gen.emit("jb ?", skip);
+        }
+    }
+    if(acc)
+        gen.emit("pxor %xmm14, %xmm14");
+
+    char* begin = make_label();
+    char* end = make_label();
+    gen.emit_label(begin);
+    gen.emit("lea ?(%rax), %r11", lanes);
+    gen.emit("cmp %rcx, %r11");
+    gen.emit("jg ?", end);
+    int depth = 0;
+    for(auto inst:code) {
+        switch(inst.first) {
+        case VEC_LOAD:
+            gen.emit("? (%?,%rax,?), %xmm?", mov, VEC_REGS[inst.second + (dst ? 1 : 0)], size, depth++);
+            break;
+        case VEC_SCALAR:
+            gen.emit("movdqa %xmm?, %xmm?", 8 + inst.second, depth++);
+            break;
+        default:
+            depth--;
+            emit_vec_op(gen, elem_type, inst.first, depth - 1, depth);
+        }
+    }
+    assert(depth == 1);
+    if(dst)
+        gen.emit("? %xmm0, (%rdx,%rax,?)", mov, size);
+    else
+        emit_vec_op(gen, elem_type, '+', 14, 0);
+    gen.emit("add $?, %rax", lanes);
+    gen.emit("jmp ?", begin);
+    gen.emit_label(end);
+    gen.emit_save(var);
+
+    if(acc) {
+        for(int shift = 8; shift >= size; shift /= 2) {
+            gen.emit("movdqa %xmm14, %xmm6");
+            gen.emit("psrldq $?, %xmm6", shift);
+            emit_vec_op(gen, elem_type, '+', 14, 6);
+        }
+        gen.emit("movq %xmm14, %rcx");
+        acc->codegen(gen);
+        gen.emit("add %rcx, %rax");
+        gen.emit_save(acc);
+    }
+    gen.emit_label(skip);
+}
+
 void ReturnNode::codegen(Generator& gen) {
     SAVE_CURRENT_POS;
+    if(return_val && (return_val->kind == NK_FUNC_CALL || return_val->kind == NK_FUNCPTR_CALL)
+        && dynamic_pointer_cast<FuncCallNode>(return_val)->is_tail_call) {
+        return_val->codegen(gen);
+        return;
+    }
     if(return_val) {
         return_val->codegen(gen);
         if(return_val->type->kind == TK_BOOL) {
             gen.emit("movzx %al, %rax");
         }
     }
-    gen.emit("leave");
-    gen.emit("ret");
+    gen.emit_epilogue();
 }
 
-static char* REGS_LOW[6] = {"dil", "sil", "dl", "cl", "r8b", "r9b"}; 
-
 void FuncDefNode::codegen(Generator& gen) {
     SAVE_CURRENT_POS;
     gen.emit(".text");
     if(!type->is_static()) 
         gen.emit_noindent(".globl ?", func_name);
     gen.emit_noindent("?:", func_name);
+    if(gen.omit_frame_pointer && gen.emit_leaf_func(static_pointer_cast<FuncDefNode>(shared_from_this())))
+        return;
     gen.emit("nop");
     gen.push("rbp");
     gen.emit("movq %rsp, %rbp");
@@ -1444,14 +2185,12 @@ void FuncDefNode::codegen(Generator& gen) {
     ftype->numgp = gprs;
     ftype->numfp = xmms;
 
-    // emit local varient
-    int localarea = 0;
+    // emit local varient, the slots are assigned by the optimizer
+    int localarea = local_area;
     for(auto var:local_vars) {
-        int size = align8(var->type->size);
-        offset -= size;
         assert(var->kind == NK_LOCAL_VAR);
-        dynamic_pointer_cast<LocalVarNode>(var)->offset = offset;
-        localarea += size;
+        shared_ptr<LocalVarNode> lvar = dynamic_pointer_cast<LocalVarNode>(var);
+        lvar->offset = offset + lvar->slot;
     }
     if(localarea) {
         gen.emit("sub $?, %rsp", localarea);
@@ -1461,16 +2200,113 @@ void FuncDefNode::codegen(Generator& gen) {
     if(body != nullptr)
         body->codegen(gen);
 
-    gen.emit("leave");
-    gen.emit("ret");
+    if(reaches_end)
+        gen.emit_epilogue();
+}
+
+char* Generator::local_addr(int offset) {
+    if(!frame_omitted)
+        return format("%d(%%rbp)", offset);
+    return format("%d(%%rsp)", offset + stack_size - 8);
+}
+
+// Release the frame and return, or jump to target for a tail call
+void Generator::emit_epilogue(const char* target) {
+    if(!frame_omitted) {
+        emit("leave");
+    }
+    else if(stack_size > 8) {
+        emit("add $?, %rsp", stack_size - 8);
+    }
+    if(target)
+        emit("jmp ?", target);
+    else
+        emit("ret");
+}
+
+// Try to emit a function without a frame pointer: locals are addressed
+// relative to rsp. A function whose body needs no stack of its own keeps
+// its locals in the red zone below rsp and does not adjust rsp at all.
+// Only leaf functions qualify, since a call would overwrite the red zone
+// and needs to know the stack alignment.
+bool Generator::emit_leaf_func(shared_ptr<FuncDefNode> func) {
+    FuncType* ftype = dynamic_cast<FuncType*>(func->type);
+    if(ftype->has_var_param) return false;
+
+    int gprs = 0, xmms = 0, offset = 0;
+    for(auto param:func->params) {
+        if(param->type->kind == TK_STRUCT) return false;
+        if(param->type->is_float_type() ? xmms++ >= 8 : gprs++ >= 6) return false;
+        offset -= 8;
+        dynamic_pointer_cast<LocalVarNode>(param)->offset = offset;
+    }
+    for(auto var:func->local_vars) {
+        shared_ptr<LocalVarNode> lvar = dynamic_pointer_cast<LocalVarNode>(var);
+        // initializers are consumed when emitted
+        if(!lvar->init_list.empty()) return false;
+        lvar->offset = offset + lvar->slot;
+    }
+    int frame = func->local_area - offset;
+
+    std::streambuf* out = fout.basic_ios<char>::rdbuf();
+    for(int red_zone = (frame <= 128); red_zone >= 0; --red_zone) {
+        std::stringbuf buf;
+        fout.basic_ios<char>::rdbuf(&buf);
+        tentative = frame_omitted = true;
+        has_call = false;
+        stack_size = 8;
+        if(!red_zone && frame > 0) {
+            emit("sub $?, %rsp", frame);
+            stack_size += frame;
+        }
+        max_stack_size = stack_size;
+
+        gprs = xmms = 0;
+        for(auto param:func->params) {
+            char* addr = local_addr(dynamic_pointer_cast<LocalVarNode>(param)->offset);
+            if(param->type->is_float_type()) {
+                emit("movsd %xmm?, ?", xmms++, addr);
+            }
+            else {
+                if(param->type->kind == TK_BOOL) {
+                    emit("movzx %?, %?", REGS_LOW[gprs], REGS[gprs]);
+                }
+                emit("movq %?, ?", REGS[gprs++], addr);
+            }
+        }
+        ftype->numgp = gprs;
+        ftype->numfp = xmms;
+
+        if(func->body != nullptr)
+            func->body->codegen(*this);
+        if(func->reaches_end)
+            emit_epilogue();
+
+        fout.basic_ios<char>::rdbuf(out);
+        tentative = frame_omitted = false;
+        if(!has_call && (!red_zone || max_stack_size == 8)) {
+            fout << buf.str();
+            return true;
+        }
+    }
+    stack_size = 8;
+    return false;
 }
 
 void Generator::run() {
     vector<NodePtr> ast = parser->get_ast();
     if(ast.size() == 0) return;
+    Optimizer optimizer(ast);
+    optimizer.optimize = optimize;
+    optimizer.run();
     current_pos = ast[0]->first_token->get_pos();
+    if(jobs > 1) {
+        run_parallel(ast);
+        return;
+    }
     for(auto node:ast) {
         stack_size = 8;
+        xmm_depth = 0;
         if(node->kind == NK_FUNC_DEF) {
             node->codegen(*this);
         }
@@ -1487,4 +2323,66 @@ void Generator::run() {
             error("invalid toplevel statement");
         }
     }
-}
\ No newline at end of file
+    emit_float_consts();
+}
+
+// Generate the functions on a pool of threads, each into its own buffer, 
+// then write the buffers and the data in source order. 
+void Generator::run_parallel(vector<NodePtr>& ast) {
+    vector<size_t> funcs;
+    for(size_t i = 0; i < ast.size(); ++i) {
+        if(ast[i]->kind == NK_FUNC_DEF)
+            funcs.push_back(i);
+    }
+    vector<string> bufs(ast.size());
+    vector<Arena> arenas(jobs);
+    atomic<size_t> next(0);
+    auto worker = [&](int id) {
+        Arena::current = &arenas[id];
+        Generator gen(parser);
+        gen.omit_frame_pointer = omit_frame_pointer;
+        gen.parallel = true;
+        for(size_t i = next++; i < funcs.size(); i = next++) {
+            NodePtr func = ast[funcs[i]];
+            std::stringbuf buf;
+            gen.fout.basic_ios<char>::rdbuf(&buf);
+            gen.current_pos = func->first_token->get_pos();
+            gen.stack_size = 8;
+            gen.xmm_depth = 0;
+            gen.float_consts.clear();
+            set_label_func(funcs[i]);
+            func->codegen(gen);
+            gen.emit_float_consts();
+            bufs[funcs[i]] = buf.str();
+        }
+        set_label_func(-1);
+        Arena::current = nullptr;
+    };
+    vector<thread> threads;
+    for(int id = 0; id < jobs; ++id)
+        threads.push_back(thread(worker, id));
+    for(auto& t:threads)
+        t.join();
+
+    for(size_t i = 0; i < ast.size(); ++i) {
+        stack_size = 8;
+        xmm_depth = 0;
+        if(ast[i]->kind == NK_FUNC_DEF) {
+            fout << bufs[i];
+        }
+        else if(ast[i]->kind == NK_DECL) {
+            shared_ptr<DeclNode> decl = dynamic_pointer_cast<DeclNode>(ast[i]);
+            if(decl->init_list.empty()) {
+                emit_bss(decl);
+            }
+            else {
+                emit_data(decl);
+            }
+        }
+        else {
+            error("invalid toplevel statement");
+        }
+    }
+    emit_float_consts();
+    fout.flush();
+}
@@ -2,6 +2,7 @@
 
 #include <unistd.h>
 #include <fstream>
+#include <map>
 #include "ast.h"
 #include "parser.h"
 
@@ -9,11 +10,14 @@ using NodePtr = std::shared_ptr<Node>;
 
 class Node;
 class DeclNode;
+class FuncDefNode;
 class Parser;
 
 class Generator {
 public:
     Generator(char* filename, Parser* parser);
+    // a generator whose output is redirected to a buffer
+    Generator(Parser* parser);
 
     void emit_noindent(char* fmt);
 
@@ -28,6 +32,8 @@ public:
     void push_xmm(int xmm_id);
     void pop_xmm(int xmm_id);
 
+    void emit_block_copy(char* src, char* dst, int size);
+    void emit_block_zero(char* base, int offset, int size);
     int push_struct(int size);
 
     void emit_bitfield_load(Type* type);
@@ -46,6 +52,7 @@ public:
     void emit_global_load(Type* type, char* label, int offset);
     void emit_global_save(Type* type, char* label, int offset);
 
+    void emit_quad_save(int64_t value, int offset);
     void emit_literal_save(NodePtr node, Type* totype, int offset);    
 
     void emit_decl_init(std::vector<NodePtr>& init_list, int offset, int total_size);
@@ -61,10 +68,20 @@ public:
 
     void emit_save(NodePtr node);
 
+    char* get_int_operand(NodePtr node, int size);
+    void emit_int_operand_op(const char* inst, char* operand, Type* type);
+    void emit_mul_imm(int64_t value);
+    bool emit_divmod_imm(int op, int64_t value, Type* type);
+
     void emit_binop_cmp(NodePtr node);
     void emit_binop_int_arith(NodePtr node);
     void emit_binop_float_arith(NodePtr node);
 
+    int save_xmm0(NodePtr node);
+    char* get_float_operand(NodePtr node, Type* type);
+    char* get_float_const(Type* type, double value);
+    void emit_float_consts();
+
     void emit_copy_struct(NodePtr from, NodePtr to);
 
     void emit_data_primtype(Type* type, NodePtr val, int subsection);
@@ -77,16 +94,40 @@ public:
 
     void emit_reg_area_save();
 
+    char* local_addr(int offset);
+    void emit_epilogue(const char* target = nullptr);
+    bool emit_leaf_func(std::shared_ptr<FuncDefNode> func);
+
     void run();
+    void run_parallel(std::vector<NodePtr>& ast);
 
 public:
     int stack_size = 0;
     Pos current_pos;
 
+    // -fomit-frame-pointer
+    bool omit_frame_pointer = false;
+    // cleared by -O0
+    bool optimize = true;
+    // state of the function being generated without a frame pointer
+    bool frame_omitted = false;
+    bool tentative = false;
+    bool has_call = false;
+    int max_stack_size = 0;
+    // number of xmm8-xmm14 in use
+    int xmm_depth = 0;
+
+    // -fparallel-jobs: number of threads generating functions
+    int jobs = 1;
+    // generating one of several functions at once, which must not share data
+    bool parallel = false;
+
 private:
     const char* get_mov_inst(Type *type);
 
 private:
     std::ofstream fout;
     Parser* parser;
+    // label of each float literal by size and bits
+    std::map<std::pair<int, uint64_t>, char*> float_consts;
 };
\ No newline at end of file
@@ -40,6 +40,7 @@ def(KW_REGISTER, "register")
 // function-speccifier
 def(KW_INLINE, "inline")
 def(KW_NORETURN, "_Noreturn")
+def(KW_ATTRIBUTE, "__attribute__")
 
 // alignment-specifier
 def(KW_ALIGNAS, "_Alignas")
@@ -37,18 +37,22 @@ bool Lexer::skip_space_aux() {
         return false;
     }
     else if(isspace(c) && c != '\n') {
+        fileset.skip_blanks();
         return true;
     }
     else if(c == '/') {
         if(fileset.next('/')) { // line comment
-            while(c != '\n' && c != EOF) 
+            while(c != '\n' && c != EOF) {
+                fileset.skip_chars("");
                 c = fileset.get_chr();
+            }
             if(c == '\n') fileset.unget_chr(c);
             return true;
         }
         else if(fileset.next('*')) { // block comment
             Pos pos = get_pos(-2); // has read "/*"
             while(true) {
+                fileset.skip_to('*');
                 c = fileset.get_chr();
                 if(c == EOF) {
                     fileset.unget_chr(c);
@@ -72,6 +76,39 @@ bool Lexer::skip_space() {
     return true;
 }
 
+// skip the rest of a line in a false conditional group without making tokens.
+// quotes may be unbalanced in such groups, so literals end at the newline.
+bool Lexer::skip_line() {
+    while(true) {
+        fileset.skip_chars("/\"'");
+        int c = fileset.get_chr();
+        switch(c) {
+        case EOF:
+            return false;
+        case '\n':
+            return true;
+        case '/':
+            fileset.unget_chr(c);
+            if(!skip_space_aux())
+                fileset.get_chr();
+            break;
+        case '"': case '\'':
+            while(true) {
+                int c1 = fileset.get_chr();
+                if(c1 == c || c1 == EOF)
+                    break;
+                if(c1 == '\n') {
+                    fileset.unget_chr(c1);
+                    break;
+                }
+                if(c1 == '\\')
+                    fileset.get_chr();
+            }
+            break;
+        }
+    }
+}
+
 /* C11 6.4.4: escape-sequence
  escape-sequence:
     simple-escape-sequence
@@ -441,7 +478,7 @@ std::shared_ptr<Token> Lexer::get_token() {
         return tok;
     }
     if(fileset.count() == 0) return make_token(TEOF, get_pos(0));
-    bool bol = (fileset.current_file().col == 1);
+    bool bol = fileset.at_line_start();
     auto tok = read_token();
     if(tok->kind == TSPACE) {
         tok = read_token();
@@ -451,6 +488,33 @@ std::shared_ptr<Token> Lexer::get_token() {
     return tok;
 }
 
+std::shared_ptr<Token> Lexer::skip_to_directive() {
+    while(buffer.size() > 0) {
+        auto tok = buffer.back();
+        buffer.pop_back();
+        if(tok->begin_of_line && tok->is_keyword('#'))
+            return tok;
+    }
+    if(fileset.count() == 0) return nullptr;
+
+    bool bol = fileset.at_line_start();
+    while(true) {
+        if(bol) {
+            skip_space();
+            int c = fileset.peek();
+            if(c == '#' || c == '%') {
+                auto tok = read_token();
+                if(tok->is_keyword('#')) {
+                    tok->begin_of_line = true;
+                    return tok;
+                }
+            }
+        }
+        bol = skip_line();
+        if(!bol) return nullptr;
+    }
+}
+
 void Lexer::unget_token(std::shared_ptr<Token> token) {
     if(token->kind == EOF) return;
     buffer.push_back(token);
@@ -25,18 +25,24 @@ public:
 
     std::shared_ptr<Token> peek_token();
     bool next(int kind);
+
+    // skip a false conditional group up to the '#' of the next directive,
+    // return nullptr at end of input
+    std::shared_ptr<Token> skip_to_directive();
 private:
 
     Pos get_pos(int delta = 0) { 
         if(fileset.count() == 0) return Pos({"-", 1, 1});
-        File& f = fileset.current_file();
-        return Pos({f.name, f.row, f.col+delta}); 
+        int row, col;
+        fileset.get_pos(&row, &col);
+        return Pos({fileset.current_file().name, row, col+delta}); 
     }
 
     void lexer_error(const Pos& pos, int c, char* fmt, ...);
 
     bool skip_space_aux();
     bool skip_space();
+    bool skip_line();
 
     int read_universal_char(int len);
     int read_octal_char(int c);
@@ -0,0 +1,2482 @@
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include "optimizer.h"
+#include "error.h"
+using namespace std;
+
+static bool has_qualifier(Type* type, int qualifier) {
+    return find(type->type_qualifier.begin(), type->type_qualifier.end(),
+        qualifier) != type->type_qualifier.end();
+}
+
+static shared_ptr<IntNode> as_int_literal(NodePtr node) {
+    if(node == nullptr || node->kind != NK_LITERAL || !node->type->is_int_type())
+        return nullptr;
+    return dynamic_pointer_cast<IntNode>(node);
+}
+
+static shared_ptr<FloatNode> as_float_literal(NodePtr node) {
+    if(node == nullptr || node->kind != NK_LITERAL || !node->type->is_float_type())
+        return nullptr;
+    return dynamic_pointer_cast<FloatNode>(node);
+}
+
+// A float literal keeps the parsed double, its value is that rounded to float
+static double float_value(shared_ptr<FloatNode> node) {
+    if(node->type->kind == TK_FLOAT)
+        return (float)node->value;
+    return node->value;
+}
+
+static bool same_type(Type* a, Type* b) {
+    return a->kind == b->kind && a->is_unsigned == b->is_unsigned && a->size == b->size;
+}
+
+// Truncate value to the width of an integer type
+static long long wrap_int(Type* type, long long value) {
+    if(type->kind == TK_BOOL)
+        return value != 0;
+    switch(type->size) {
+    case 1: return type->is_unsigned ? (long long)(uint8_t)value : (long long)(int8_t)value;
+    case 2: return type->is_unsigned ? (long long)(uint16_t)value : (long long)(int16_t)value;
+    case 4: return type->is_unsigned ? (long long)(uint32_t)value : (long long)(int32_t)value;
+    default: return value;
+    }
+}
+
+static long long all_ones(Type* type) {
+    return wrap_int(type, -1);
+}
+
+// Whether evaluating the expression has no side effects
+static bool is_pure(NodePtr node) {
+    if(node->type && has_qualifier(node->type, KW_VOLATILE))
+        return false;
+    switch(node->kind) {
+    case NK_LITERAL: case NK_GLOBAL_VAR: case NK_FUNC_DESG:
+        return true;
+    case NK_LOCAL_VAR:
+        return dynamic_pointer_cast<LocalVarNode>(node)->init_list.empty();
+    case NK_CONV: case NK_CAST: case '~': case '!':
+        return is_pure(dynamic_pointer_cast<UnaryOperNode>(node)->operand);
+    case '+': case '-': case '*': case '&': case '|': case '^':
+    case '<': case P_LE: case P_EQ: case P_NE: case P_LOGAND: case P_LOGOR:
+    case NK_SAL: case NK_SAR: case NK_SHR: {
+        shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node);
+        return expr && is_pure(expr->left) && is_pure(expr->right);
+    }
+    default:
+        return false;
+    }
+}
+
+static bool is_boolean_expr(NodePtr node) {
+    switch(node->kind) {
+    case '<': case P_LE: case P_EQ: case P_NE: case P_LOGAND: case P_LOGOR:
+        return dynamic_pointer_cast<BinaryOperNode>(node) != nullptr;
+    case '!':
+        return true;
+    }
+    return false;
+}
+
+// Labels may be the target of a jump from live code
+static bool contains_label(NodePtr node) {
+    if(node == nullptr)
+        return false;
+    switch(node->kind) {
+    case NK_LABEL:
+        return true;
+    case NK_COMPOUND_STMT: {
+        for(auto stmt:dynamic_pointer_cast<CompoundStmtNode>(node)->list) {
+            if(contains_label(stmt)) return true;
+        }
+        return false;
+    }
+    case NK_IF: {
+        shared_ptr<IfNode> stmt = dynamic_pointer_cast<IfNode>(node);
+        return contains_label(stmt->then) || contains_label(stmt->els);
+    }
+    default:
+        return false;
+    }
+}
+
+// C11 6.3.1: integer and floating conversions of a literal
+static NodePtr convert_literal(NodePtr node, Type* type) {
+    shared_ptr<IntNode> ival = as_int_literal(node);
+    shared_ptr<FloatNode> fval = as_float_literal(node);
+    if(type->is_int_type()) {
+        long long value;
+        if(ival) {
+            value = ival->value;
+        }
+        else if(fval) {
+            if(type->kind == TK_BOOL)
+                value = (float_value(fval) != 0);
+            else if(type->is_unsigned && type->size == 8)
+                value = (long long)(unsigned long long)float_value(fval);
+            else
+                value = (long long)float_value(fval);
+        }
+        else {
+            return nullptr;
+        }
+        return make_int_node(node->first_token, type, wrap_int(type, value));
+    }
+    if(type->is_float_type()) {
+        double value;
+        if(ival)
+            value = (node->type->is_unsigned && node->type->size == 8)
+                ? (double)(unsigned long long)ival->value : (double)ival->value;
+        else if(fval)
+            value = float_value(fval);
+        else
+            return nullptr;
+        if(type->kind == TK_FLOAT)
+            value = (float)value;
+        return make_float_node(node->first_token, type, value);
+    }
+    return nullptr;
+}
+
+// Evaluate "left op right" in the integer type; return false if it cannot be folded
+static bool eval_int_binop(int op, Type* type, long long left, long long right, long long& result) {
+    int bits = type->size * 8;
+    bool is_unsigned = type->is_unsigned;
+    uint64_t ul = (uint64_t)wrap_int(type, left), ur = (uint64_t)wrap_int(type, right);
+    left = wrap_int(type, left);
+    right = wrap_int(type, right);
+    switch(op) {
+    case '+': result = ul + ur; break;
+    case '-': result = ul - ur; break;
+    case '*': result = ul * ur; break;
+    case '/': case '%': {
+        if(right == 0)
+            return false;
+        if(is_unsigned) {
+            if(bits < 64) { ul &= (1ULL << bits) - 1; ur &= (1ULL << bits) - 1; }
+            result = (op == '/') ? ul / ur : ul % ur;
+        }
+        else {
+            long long min = (bits == 64) ? INT64_MIN : -(1LL << (bits - 1));
+            if(right == -1 && left == min)
+                return false;
+            result = (op == '/') ? left / right : left % right;
+        }
+        break;
+    }
+    case '&': result = ul & ur; break;
+    case '|': result = ul | ur; break;
+    case '^': result = ul ^ ur; break;
+    case NK_SAL: case NK_SAR: case NK_SHR: {
+        if(right < 0 || right >= bits)
+            return false;
+        if(op == NK_SAL)
+            result = ul << right;
+        else if(op == NK_SAR && !is_unsigned)
+            result = left >> right;
+        else
+            result = (bits < 64 ? (ul & ((1ULL << bits) - 1)) : ul) >> right;
+        break;
+    }
+    case '<':
+        result = is_unsigned ? (uint64_t)left < (uint64_t)right : left < right;
+        return true;
+    case P_LE:
+        result = is_unsigned ? (uint64_t)left <= (uint64_t)right : left <= right;
+        return true;
+    case P_EQ: result = (left == right); return true;
+    case P_NE: result = (left != right); return true;
+    default:
+        return false;
+    }
+    result = wrap_int(type, result);
+    return true;
+}
+
+static bool eval_float_binop(int op, Type* type, double left, double right, double& result) {
+    switch(op) {
+    case '+': result = left + right; break;
+    case '-': result = left - right; break;
+    case '*': result = left * right; break;
+    case '/': result = left / right; break;
+    case '<': result = left < right; return true;
+    case P_LE: result = left <= right; return true;
+    case P_EQ: result = left == right; return true;
+    case P_NE: result = left != right; return true;
+    default:
+        return false;
+    }
+    if(type->kind == TK_FLOAT)
+        result = (float)result;
+    return true;
+}
+
+// -------------------------------- constant folding --------------------------------
+
+// Fold the subexpressions of an lvalue, but keep the lvalue itself
+NodePtr Optimizer::fold_lvalue(NodePtr node) {
+    switch(node->kind) {
+    case NK_DEREF: {
+        shared_ptr<UnaryOperNode> deref = dynamic_pointer_cast<UnaryOperNode>(node);
+        deref->operand = fold(deref->operand);
+        return node;
+    }
+    case NK_STRUCT_MEMBER: {
+        shared_ptr<StructMemberNode> member = dynamic_pointer_cast<StructMemberNode>(node);
+        member->struc = fold_lvalue(member->struc);
+        return node;
+    }
+    case NK_LOCAL_VAR: {
+        fold_init_list(dynamic_pointer_cast<LocalVarNode>(node)->init_list);
+        return node;
+    }
+    default:
+        return fold(node);
+    }
+}
+
+NodePtr Optimizer::fold_unary(shared_ptr<UnaryOperNode> node) {
+    switch(node->kind) {
+    case NK_ADDR: case NK_PRE_INC: case NK_PRE_DEC: case NK_POST_INC: case NK_POST_DEC:
+        node->operand = fold_lvalue(node->operand);
+        return node;
+    case NK_DEREF:
+        return fold_lvalue(node);
+    }
+    node->operand = fold(node->operand);
+    NodePtr operand = node->operand;
+    shared_ptr<IntNode> ival = as_int_literal(operand);
+    shared_ptr<FloatNode> fval = as_float_literal(operand);
+    if(!ival && !fval)
+        return node;
+    switch(node->kind) {
+    case NK_CONV: case NK_CAST: {
+        NodePtr res = convert_literal(operand, node->type);
+        return res ? res : node;
+    }
+    case '~':
+        if(ival && node->type->is_int_type())
+            return make_int_node(node->first_token, node->type, wrap_int(node->type, ~ival->value));
+        return node;
+    case '!': {
+        bool value = ival ? ival->value == 0 : float_value(fval) == 0;
+        return make_int_node(node->first_token, node->type, value);
+    }
+    }
+    return node;
+}
+
+NodePtr Optimizer::fold_binary(shared_ptr<BinaryOperNode> node) {
+    int op = node->kind;
+    if(op == '=') {
+        node->left = fold_lvalue(node->left);
+        node->right = fold(node->right);
+        return node;
+    }
+    node->left = fold(node->left);
+    node->right = fold(node->right);
+    NodePtr left = node->left, right = node->right;
+    TokenPtr tok = node->first_token;
+    Type* type = node->type;
+
+    if(op == ',')
+        return is_pure(left) ? right : node;
+
+    shared_ptr<IntNode> li = as_int_literal(left), ri = as_int_literal(right);
+    shared_ptr<FloatNode> lf = as_float_literal(left), rf = as_float_literal(right);
+    bool left_const = li || lf, right_const = ri || rf;
+
+    if(op == P_LOGAND || op == P_LOGOR) {
+        if(!left_const)
+            return node;
+        bool lvalue = li ? li->value != 0 : float_value(lf) != 0;
+        // 0 && x => 0, 1 || x => 1
+        if(lvalue == (op == P_LOGOR))
+            return make_int_node(tok, type, lvalue);
+        if(right_const)
+            return make_int_node(tok, type, ri ? ri->value != 0 : float_value(rf) != 0);
+        // 1 && x => x, 0 || x => x, if x is already 0 or 1
+        if(is_boolean_expr(right) && same_type(right->type, type))
+            return right;
+        return node;
+    }
+
+    if(left_const && right_const) {
+        if(li && ri && type->is_int_type()) {
+            long long result;
+            Type* operand_type = left->type;
+            if(eval_int_binop(op, operand_type, li->value, ri->value, result))
+                return make_int_node(tok, type, wrap_int(type, result));
+        }
+        if(left->type->is_float_type() && right->type->is_float_type()) {
+            double result;
+            double lv = lf ? float_value(lf) : li->value, rv = rf ? float_value(rf) : ri->value;
+            if(eval_float_binop(op, type, lv, rv, result)) {
+                if(type->is_float_type())
+                    return make_float_node(tok, type, result);
+                return make_int_node(tok, type, (long long)result);
+            }
+        }
+        return node;
+    }
+
+    if(!type->is_int_type() && type->kind != TK_PTR)
+        return node;
+
+    // Reassociate (x op c1) op c2 => x op (c1 op c2)
+    if(ri && type->is_int_type() && (op == '+' || op == '*' || op == '&' || op == '|' || op == '^')) {
+        shared_ptr<BinaryOperNode> inner = dynamic_pointer_cast<BinaryOperNode>(left);
+        if(inner && inner->kind == op && same_type(inner->type, type)) {
+            shared_ptr<IntNode> c1 = as_int_literal(inner->right);
+            NodePtr x = inner->left;
+            if(!c1) {
+                c1 = as_int_literal(inner->left);
+                x = inner->right;
+            }
+            long long result;
+            if(c1 && eval_int_binop(op, type, c1->value, ri->value, result)) {
+                node->left = x;
+                node->right = make_int_node(tok, ri->type, result);
+                return fold_binary(node);
+            }
+        }
+    }
+
+    // algebraic identities
+    shared_ptr<IntNode> c = ri ? ri : li;
+    NodePtr x = ri ? left : right;
+    if(!c || !(x->type->is_int_type() || x->type->kind == TK_PTR))
+        return node;
+    bool keep_x = same_type(x->type, type);
+    bool drop_x = is_pure(x) && type->is_int_type();
+    long long value = wrap_int(c->type, c->value);
+    bool commutative = (op == '+' || op == '*' || op == '&' || op == '|' || op == '^');
+    if(!ri && !commutative)
+        return node;
+    switch(op) {
+    case '+': case '-': case '|': case '^': case NK_SAL: case NK_SAR: case NK_SHR:
+        if(value == 0 && keep_x) return x;
+        if(op == '|' && value == all_ones(type) && drop_x)
+            return make_int_node(tok, type, all_ones(type));
+        break;
+    case '*':
+        if(value == 1 && keep_x) return x;
+        if(value == 0 && drop_x) return make_int_node(tok, type, 0);
+        break;
+    case '/':
+        if(value == 1 && keep_x) return x;
+        break;
+    case '%':
+        if(value == 1 && drop_x) return make_int_node(tok, type, 0);
+        break;
+    case '&':
+        if(value == all_ones(type) && keep_x) return x;
+        if(value == 0 && drop_x) return make_int_node(tok, type, 0);
+        break;
+    }
+    return node;
+}
+
+NodePtr Optimizer::fold_ternary(shared_ptr<TernaryOperNode> node) {
+    node->cond = fold(node->cond);
+    if(node->then)
+        node->then = fold(node->then);
+    node->els = fold(node->els);
+    shared_ptr<IntNode> ival = as_int_literal(node->cond);
+    shared_ptr<FloatNode> fval = as_float_literal(node->cond);
+    if(!ival && !fval)
+        return node;
+    bool cond = ival ? ival->value != 0 : float_value(fval) != 0;
+    NodePtr res = cond ? (node->then ? node->then : node->cond) : node->els;
+    if(res->type == node->type || (res->type->is_arith_type() && same_type(res->type, node->type)))
+        return res;
+    return node;
+}
+
+NodePtr Optimizer::fold_if(shared_ptr<IfNode> node) {
+    node->cond = fold(node->cond);
+    if(node->then)
+        node->then = fold(node->then);
+    if(node->els)
+        node->els = fold(node->els);
+    shared_ptr<IntNode> ival = as_int_literal(node->cond);
+    shared_ptr<FloatNode> fval = as_float_literal(node->cond);
+    if(!ival && !fval)
+        return node;
+    bool cond = ival ? ival->value != 0 : float_value(fval) != 0;
+    NodePtr live = cond ? node->then : node->els;
+    NodePtr dead = cond ? node->els : node->then;
+    if(contains_label(dead))
+        return node;
+    if(live)
+        return live;
+    return make_compound_stmt_node(node->first_token, vector<NodePtr>());
+}
+
+void Optimizer::fold_init_list(vector<NodePtr>& init_list) {
+    for(auto item:init_list) {
+        shared_ptr<InitNode> init = dynamic_pointer_cast<InitNode>(item);
+        init->value = fold(init->value);
+    }
+}
+
+void Optimizer::fold_decl(shared_ptr<DeclNode> decl) {
+    fold_init_list(decl->init_list);
+    Type* type = decl->var->type;
+    if(decl->var->kind != NK_LOCAL_VAR || !type->is_arith_type() || type->bitsize > 0
+        || !has_qualifier(type, KW_CONST) || has_qualifier(type, KW_VOLATILE)
+        || decl->init_list.size() != 1)
+        return;
+    shared_ptr<InitNode> init = dynamic_pointer_cast<InitNode>(decl->init_list[0]);
+    NodePtr value = convert_literal(init->value, type);
+    if(init->offset == 0 && value)
+        const_vars[decl->var.get()] = value;
+}
+
+NodePtr Optimizer::fold(NodePtr node) {
+    if(node == nullptr)
+        return node;
+    switch(node->kind) {
+    case NK_LOCAL_VAR: {
+        auto iter = const_vars.find(node.get());
+        if(iter != const_vars.end())
+            return iter->second;
+        return fold_lvalue(node);
+    }
+    case NK_STRUCT_MEMBER: case NK_DEREF:
+        return fold_lvalue(node);
+    case NK_TERNARY:
+        return fold_ternary(dynamic_pointer_cast<TernaryOperNode>(node));
+    case NK_FUNC_CALL: case NK_FUNCPTR_CALL: {
+        shared_ptr<FuncCallNode> call = dynamic_pointer_cast<FuncCallNode>(node);
+        if(call->func_ptr)
+            call->func_ptr = fold(call->func_ptr);
+        for(auto& arg:call->args)
+            arg = fold(arg);
+        return node;
+    }
+    case NK_DECL:
+        fold_decl(dynamic_pointer_cast<DeclNode>(node));
+        return node;
+    case NK_IF:
+        return fold_if(dynamic_pointer_cast<IfNode>(node));
+    case NK_COMPOUND_STMT: {
+        shared_ptr<CompoundStmtNode> stmt = dynamic_pointer_cast<CompoundStmtNode>(node);
+        for(auto& item:stmt->list)
+            item = fold(item);
+        return node;
+    }
+    case NK_RETURN: {
+        shared_ptr<ReturnNode> ret = dynamic_pointer_cast<ReturnNode>(node);
+        ret->return_val = fold(ret->return_val);
+        return node;
+    }
+    case NK_JUMP_TABLE: {
+        shared_ptr<JumpTableNode> table = dynamic_pointer_cast<JumpTableNode>(node);
+        table->var = fold(table->var);
+        return node;
+    }
+    case NK_FUNC_DEF: {
+        shared_ptr<FuncDefNode> func = dynamic_pointer_cast<FuncDefNode>(node);
+        func->body = fold(func->body);
+        return node;
+    }
+    }
+    if(shared_ptr<UnaryOperNode> unary = dynamic_pointer_cast<UnaryOperNode>(node))
+        return fold_unary(unary);
+    if(shared_ptr<BinaryOperNode> binary = dynamic_pointer_cast<BinaryOperNode>(node))
+        return fold_binary(binary);
+    return node;
+}
+
+// ---------------------------------- inlining ----------------------------------
+
+// Cost limits, measured in AST nodes
+#define INLINE_COST_MAX 24          // callee body of any function
+#define INLINE_HINT_COST_MAX 96     // callee body of a function declared inline
+#define INLINE_UNIT_GROWTH_MAX 320  // total size of all copies of a static function
+#define INLINE_CALLER_COST_MAX 4000 // a caller stops growing beyond this size
+
+// Call f on every non-null child slot of node
+void for_each_child(NodePtr node, const function<void(NodePtr&)>& f) {
+    auto visit = [&](NodePtr& child) { if(child) f(child); };
+    switch(node->kind) {
+    case NK_LITERAL: case NK_GLOBAL_VAR: case NK_FUNC_DESG: case NK_TYPEDEF:
+    case NK_LABEL: case NK_JUMP: case NK_LABEL_ADDR:
+        return;
+    case NK_LOCAL_VAR:
+        for(auto& init:dynamic_pointer_cast<LocalVarNode>(node)->init_list) visit(init);
+        return;
+    case NK_TERNARY: {
+        shared_ptr<TernaryOperNode> expr = dynamic_pointer_cast<TernaryOperNode>(node);
+        visit(expr->cond); visit(expr->then); visit(expr->els);
+        return;
+    }
+    case NK_FUNC_CALL: case NK_FUNCPTR_CALL: {
+        shared_ptr<FuncCallNode> call = dynamic_pointer_cast<FuncCallNode>(node);
+        visit(call->func_ptr);
+        for(auto& arg:call->args) visit(arg);
+        return;
+    }
+    case NK_STRUCT_MEMBER:
+        visit(dynamic_pointer_cast<StructMemberNode>(node)->struc);
+        return;
+    case NK_INIT:
+        visit(dynamic_pointer_cast<InitNode>(node)->value);
+        return;
+    case NK_DECL: {
+        shared_ptr<DeclNode> decl = dynamic_pointer_cast<DeclNode>(node);
+        visit(decl->var);
+        for(auto& init:decl->init_list) visit(init);
+        return;
+    }
+    case NK_COMPOUND_STMT:
+        for(auto& stmt:dynamic_pointer_cast<CompoundStmtNode>(node)->list) visit(stmt);
+        return;
+    case NK_IF: {
+        shared_ptr<IfNode> stmt = dynamic_pointer_cast<IfNode>(node);
+        visit(stmt->cond); visit(stmt->then); visit(stmt->els);
+        return;
+    }
+    case NK_JUMP_TABLE:
+        visit(dynamic_pointer_cast<JumpTableNode>(node)->var);
+        return;
+    case NK_RETURN:
+        visit(dynamic_pointer_cast<ReturnNode>(node)->return_val);
+        return;
+    case NK_FUNC_DEF:
+        visit(dynamic_pointer_cast<FuncDefNode>(node)->body);
+        return;
+    case NK_VECTOR_LOOP: {
+        shared_ptr<VectorLoopNode> loop = dynamic_pointer_cast<VectorLoopNode>(node);
+        visit(loop->var); visit(loop->bound); visit(loop->dst); visit(loop->acc);
+        for(auto& array:loop->arrays) visit(array);
+        for(auto& scalar:loop->scalars) visit(scalar);
+        return;
+    }
+    }
+    if(shared_ptr<UnaryOperNode> unary = dynamic_pointer_cast<UnaryOperNode>(node)) {
+        visit(unary->operand);
+    }
+    else if(shared_ptr<BinaryOperNode> binary = dynamic_pointer_cast<BinaryOperNode>(node)) {
+        visit(binary->left);
+        visit(binary->right);
+    }
+}
+
+static int count_nodes(NodePtr node) {
+    if(node == nullptr)
+        return 0;
+    int count = 1;
+    for_each_child(node, [&](NodePtr& child) { count += count_nodes(child); });
+    return count;
+}
+
+// Nodes that are generated more than once: those reachable from more than one parent,
+// e.g. the lvalue of a compound assignment, and the operand of ++ and --
+static void find_shared_nodes(NodePtr node, set<Node*>& seen, set<Node*>& shared) {
+    if(!seen.insert(node.get()).second) {
+        shared.insert(node.get());
+        return;
+    }
+    switch(node->kind) {
+    case NK_PRE_INC: case NK_PRE_DEC: case NK_POST_INC: case NK_POST_DEC:
+        shared.insert(dynamic_pointer_cast<UnaryOperNode>(node)->operand.get());
+        return;
+    }
+    for_each_child(node, [&](NodePtr& child) { find_shared_nodes(child, seen, shared); });
+}
+
+static void find_func_refs(NodePtr node, const function<void(char*, bool)>& f) {
+    if(node->kind == NK_FUNC_CALL)
+        f(dynamic_pointer_cast<FuncCallNode>(node)->func_name, true);
+    else if(node->kind == NK_FUNC_DESG)
+        f(dynamic_pointer_cast<FuncDesignatorNode>(node)->func_name, false);
+    for_each_child(node, [&](NodePtr& child) { find_func_refs(child, f); });
+}
+
+// Computed gotos cannot be moved into another function
+static bool has_label_addr(NodePtr node) {
+    if(node->kind == NK_LABEL_ADDR || node->kind == NK_COMPUTED_GOTO)
+        return true;
+    bool found = false;
+    for_each_child(node, [&](NodePtr& child) { found = found || has_label_addr(child); });
+    return found;
+}
+
+// Collect the calls that are the value of a return statement
+static void find_return_calls(NodePtr node, set<Node*>& calls) {
+    if(node->kind == NK_RETURN) {
+        NodePtr val = dynamic_pointer_cast<ReturnNode>(node)->return_val;
+        if(val && (val->kind == NK_FUNC_CALL || val->kind == NK_FUNCPTR_CALL))
+            calls.insert(val.get());
+    }
+    for_each_child(node, [&](NodePtr& child) { find_return_calls(child, calls); });
+}
+
+static bool has_return_call(NodePtr node) {
+    set<Node*> calls;
+    find_return_calls(node, calls);
+    return !calls.empty();
+}
+
+// Whether var is assigned, incremented or has its address taken in node
+static bool is_modified(NodePtr node, Node* var) {
+    switch(node->kind) {
+    case '=': 
+        if(dynamic_pointer_cast<BinaryOperNode>(node)->left.get() == var)
+            return true;
+        break;
+    case NK_ADDR: case NK_PRE_INC: case NK_PRE_DEC: case NK_POST_INC: case NK_POST_DEC:
+        if(dynamic_pointer_cast<UnaryOperNode>(node)->operand.get() == var)
+            return true;
+        break;
+    }
+    bool found = false;
+    for_each_child(node, [&](NodePtr& child) { found = found || is_modified(child, var); });
+    return found;
+}
+
+static bool is_scalar_value(Type* type) {
+    return (type->is_arith_type() || type->kind == TK_PTR) && type->bitsize <= 0;
+}
+
+// State of copying a callee body into one call site
+struct InlineContext {
+    shared_ptr<FuncDefNode> caller;
+    map<Node*, NodePtr> vars;
+    map<Node*, NodePtr> copies;
+    map<char*, char*, cstr_cmp> labels;
+    NodePtr ret_var;
+    char* ret_label;
+    int ret_jumps = 0;
+};
+
+static shared_ptr<LocalVarNode> copy_localvar(NodePtr node, InlineContext& ctx) {
+    shared_ptr<LocalVarNode> var = dynamic_pointer_cast<LocalVarNode>(node);
+    shared_ptr<LocalVarNode> copy = shared_ptr<LocalVarNode>(
+        new LocalVarNode(var->first_token, var->type, var->var_name));
+    ctx.caller->local_vars.push_back(copy);
+    ctx.vars[var.get()] = copy;
+    return copy;
+}
+
+static char* rename_label(char* label, InlineContext& ctx) {
+    auto iter = ctx.labels.find(label);
+    if(iter != ctx.labels.end())
+        return iter->second;
+    return ctx.labels[label] = make_label();
+}
+
+// Copy node with fresh locals and labels. Returns become a store to ret_var
+// followed by a jump to ret_label. Sharing between nodes is preserved.
+static NodePtr clone_node(NodePtr node, InlineContext& ctx) {
+    if(node == nullptr)
+        return node;
+    auto iter = ctx.copies.find(node.get());
+    if(iter != ctx.copies.end())
+        return iter->second;
+
+    TokenPtr tok = node->first_token;
+    NodePtr copy;
+    switch(node->kind) {
+    case NK_LITERAL: case NK_GLOBAL_VAR: case NK_FUNC_DESG: case NK_TYPEDEF:
+        return node;
+    case NK_LOCAL_VAR: {
+        auto var = ctx.vars.find(node.get());
+        if(var != ctx.vars.end())
+            return var->second;
+        shared_ptr<LocalVarNode> lvar = copy_localvar(node, ctx);
+        for(auto init:dynamic_pointer_cast<LocalVarNode>(node)->init_list)
+            lvar->init_list.push_back(clone_node(init, ctx));
+        return lvar;
+    }
+    case NK_LABEL: {
+        shared_ptr<LabelNode> label = dynamic_pointer_cast<LabelNode>(node);
+        return ctx.copies[node.get()] = 
+            make_label_node(tok, label->origin_label, rename_label(label->normal_label, ctx));
+    }
+    case NK_JUMP: {
+        shared_ptr<JumpNode> jump = dynamic_pointer_cast<JumpNode>(node);
+        return ctx.copies[node.get()] = 
+            make_jump_node(tok, jump->origin_label, rename_label(jump->normal_label, ctx));
+    }
+    case NK_JUMP_TABLE: {
+        shared_ptr<JumpTableNode> table = dynamic_pointer_cast<JumpTableNode>(node);
+        vector<char*> labels;
+        for(auto label:table->labels)
+            labels.push_back(rename_label(label, ctx));
+        return ctx.copies[node.get()] = make_jump_table_node(tok, clone_node(table->var, ctx), 
+            table->min, labels, rename_label(table->default_label, ctx));
+    }
+    case NK_RETURN: {
+        NodePtr value = clone_node(dynamic_pointer_cast<ReturnNode>(node)->return_val, ctx);
+        vector<NodePtr> list;
+        if(value && ctx.ret_var)
+            list.push_back(make_binary_oper_node(tok, '=', ctx.ret_var->type, ctx.ret_var, value));
+        else if(value)
+            list.push_back(value);
+        list.push_back(make_jump_node(tok, ctx.ret_label, ctx.ret_label));
+        ctx.ret_jumps++;
+        return ctx.copies[node.get()] = make_compound_stmt_node(tok, list);
+    }
+    case NK_TERNARY:
+        copy = arena_make<TernaryOperNode>(*dynamic_pointer_cast<TernaryOperNode>(node));
+        break;
+    case NK_FUNC_CALL: case NK_FUNCPTR_CALL:
+        copy = arena_make<FuncCallNode>(*dynamic_pointer_cast<FuncCallNode>(node));
+        break;
+    case NK_STRUCT_MEMBER:
+        copy = arena_make<StructMemberNode>(*dynamic_pointer_cast<StructMemberNode>(node));
+        break;
+    case NK_INIT:
+        copy = arena_make<InitNode>(*dynamic_pointer_cast<InitNode>(node));
+        break;
+    case NK_DECL:
+        copy = arena_make<DeclNode>(*dynamic_pointer_cast<DeclNode>(node));
+        break;
+    case NK_COMPOUND_STMT:
+        copy = arena_make<CompoundStmtNode>(*dynamic_pointer_cast<CompoundStmtNode>(node));
+        break;
+    case NK_IF:
+        copy = arena_make<IfNode>(*dynamic_pointer_cast<IfNode>(node));
+        break;
+    default:
+        if(shared_ptr<UnaryOperNode> unary = dynamic_pointer_cast<UnaryOperNode>(node))
+            copy = arena_make<UnaryOperNode>(*unary);
+        else if(shared_ptr<BinaryOperNode> binary = dynamic_pointer_cast<BinaryOperNode>(node))
+            copy = arena_make<BinaryOperNode>(*binary);
+        else
+            error("internal error: cannot inline node, kind: %d", node->kind);
+    }
+    for_each_child(copy, [&](NodePtr& child) { child = clone_node(child, ctx); });
+    ctx.copies[node.get()] = copy;
+    return copy;
+}
+
+bool Optimizer::should_inline(shared_ptr<FuncDefNode> callee, shared_ptr<FuncCallNode> call, 
+    shared_ptr<FuncDefNode> caller) {
+    FuncType* ftype = dynamic_cast<FuncType*>(callee->type);
+    if(callee == caller || ftype->is_noinline || ftype->has_var_param || ftype->is_old_style)
+        return false;
+    if(call->args.size() != callee->params.size())
+        return false;
+    if(ftype->return_type->kind != TK_VOID && !is_scalar_value(ftype->return_type))
+        return false;
+    for(auto param:callee->params) {
+        if(!is_scalar_value(param->type))
+            return false;
+    }
+    if(callee->body && has_label_addr(callee->body))
+        return false;
+    // inlining "return f()" into "return g()" would turn the tail call of f into a call
+    if(tail_sites.count(call.get()) && callee->body && has_return_call(callee->body))
+        return false;
+    if(ftype->is_always_inline)
+        return true;
+
+    int cost = count_nodes(callee->body);
+    if(caller_cost + cost > INLINE_CALLER_COST_MAX)
+        return false;
+    if(cost <= (ftype->is_inline ? INLINE_HINT_COST_MAX : INLINE_COST_MAX))
+        return true;
+    // If every call of a static function is inlined, its own copy is removed afterwards
+    return ftype->is_static() && !address_taken.count(callee->func_name) 
+        && cost * call_count[callee->func_name] <= INLINE_UNIT_GROWTH_MAX;
+}
+
+// f(a, b) => ({ p1 = a; p2 = b; body; ret_label: ret_var; })
+NodePtr Optimizer::inline_call(shared_ptr<FuncDefNode> callee, shared_ptr<FuncCallNode> call, 
+    shared_ptr<FuncDefNode> caller) {
+    FuncType* ftype = dynamic_cast<FuncType*>(callee->type);
+    TokenPtr tok = call->first_token;
+    InlineContext ctx;
+    ctx.caller = caller;
+    vector<NodePtr> list;
+
+    for(size_t i = 0; i < callee->params.size(); ++i) {
+        NodePtr param = callee->params[i], arg = call->args[i];
+        if(!same_type(arg->type, param->type))
+            arg = make_unary_oper_node(tok, NK_CONV, param->type, arg);
+        // A literal argument of a parameter that is never written is substituted directly
+        NodePtr value = convert_literal(arg, param->type);
+        if(value && !(callee->body && is_modified(callee->body, param.get()))) {
+            ctx.vars[param.get()] = value;
+            continue;
+        }
+        NodePtr var = copy_localvar(param, ctx);
+        list.push_back(make_binary_oper_node(tok, '=', param->type, var, arg));
+    }
+    for(auto var:callee->local_vars) {
+        copy_localvar(var, ctx);
+    }
+    for(auto var:callee->local_vars) {
+        shared_ptr<LocalVarNode> copy = dynamic_pointer_cast<LocalVarNode>(ctx.vars[var.get()]);
+        for(auto init:dynamic_pointer_cast<LocalVarNode>(var)->init_list)
+            copy->init_list.push_back(clone_node(init, ctx));
+    }
+    if(ftype->return_type->kind != TK_VOID) {
+        ctx.ret_var = arena_make<LocalVarNode>(tok, ftype->return_type, make_tmpname());
+        caller->local_vars.push_back(ctx.ret_var);
+    }
+    ctx.ret_label = make_label();
+
+    NodePtr body = clone_node(callee->body, ctx);
+    if(body) {
+        // The return at the end of the body falls through to ret_label
+        shared_ptr<CompoundStmtNode> stmts = dynamic_pointer_cast<CompoundStmtNode>(body);
+        shared_ptr<CompoundStmtNode> last = stmts && !stmts->list.empty() ?
+            dynamic_pointer_cast<CompoundStmtNode>(stmts->list.back()) : nullptr;
+        if(last && !last->list.empty() && last->list.back()->kind == NK_JUMP
+            && dynamic_pointer_cast<JumpNode>(last->list.back())->normal_label == ctx.ret_label) {
+            last->list.pop_back();
+            ctx.ret_jumps--;
+        }
+        list.push_back(body);
+    }
+    if(ctx.ret_jumps > 0)
+        list.push_back(make_label_node(tok, ctx.ret_label, ctx.ret_label));
+    if(ctx.ret_var)
+        list.push_back(ctx.ret_var);
+
+    NodePtr expr = make_compound_stmt_node(tok, list);
+    expr->type = ctx.ret_var ? ftype->return_type : type_void;
+    return expr;
+}
+
+void Optimizer::inline_calls(NodePtr& node, shared_ptr<FuncDefNode> caller) {
+    if(node == nullptr || shared_nodes.count(node.get()))
+        return;
+    for_each_child(node, [&](NodePtr& child) { inline_calls(child, caller); });
+    if(node->kind != NK_FUNC_CALL)
+        return;
+    shared_ptr<FuncCallNode> call = dynamic_pointer_cast<FuncCallNode>(node);
+    auto iter = funcs.find(call->func_name);
+    if(iter == funcs.end() || !should_inline(iter->second, call, caller))
+        return;
+    caller_cost += count_nodes(iter->second->body);
+    node = inline_call(iter->second, call, caller);
+}
+
+// Functions are visited in definition order, so callees defined earlier
+// have already been expanded. Inlined copies are not expanded again,
+// which bounds the work for recursive functions.
+void Optimizer::inline_functions() {
+    for(auto node:ast) {
+        if(node->kind == NK_FUNC_DEF) {
+            shared_ptr<FuncDefNode> func = dynamic_pointer_cast<FuncDefNode>(node);
+            funcs[func->func_name] = func;
+        }
+        find_func_refs(node, [&](char* name, bool is_call) {
+            if(is_call) call_count[name]++;
+            else address_taken.insert(name);
+        });
+    }
+    for(auto node:ast) {
+        if(node->kind != NK_FUNC_DEF)
+            continue;
+        shared_ptr<FuncDefNode> caller = dynamic_pointer_cast<FuncDefNode>(node);
+        if(caller->body == nullptr)
+            continue;
+        set<Node*> seen;
+        shared_nodes.clear();
+        find_shared_nodes(caller->body, seen, shared_nodes);
+        tail_sites.clear();
+        find_return_calls(caller->body, tail_sites);
+        caller_cost = count_nodes(caller->body);
+        inline_calls(caller->body, caller);
+    }
+}
+
+static void find_global_refs(NodePtr node, set<char*, cstr_cmp>& labels) {
+    if(node->kind == NK_GLOBAL_VAR)
+        labels.insert(dynamic_pointer_cast<GlobalVarNode>(node)->global_label);
+    for_each_child(node, [&](NodePtr& child) { find_global_refs(child, labels); });
+}
+
+static bool is_static_decl(NodePtr node) {
+    return node->kind == NK_DECL && node->type->is_static();
+}
+
+static char* decl_label(NodePtr node) {
+    NodePtr var = dynamic_pointer_cast<DeclNode>(node)->var;
+    return dynamic_pointer_cast<GlobalVarNode>(var)->global_label;
+}
+
+// Drop static functions and static variables (including static locals) that are 
+// no longer referenced after inlining and dead code elimination
+void Optimizer::remove_unused_symbols() {
+    set<char*, cstr_cmp> live, live_vars;
+    map<char*, vector<NodePtr>, cstr_cmp> decls;
+    vector<NodePtr> worklist;
+    for(auto node:ast) {
+        if(is_static_decl(node))
+            decls[decl_label(node)].push_back(node);
+        else if(node->kind == NK_DECL) 
+            for(auto init:dynamic_pointer_cast<DeclNode>(node)->init_list)
+                worklist.push_back(init);
+        else if(node->kind != NK_FUNC_DEF || !node->type->is_static())
+            worklist.push_back(node);
+    }
+    while(!worklist.empty()) {
+        NodePtr node = worklist.back();
+        worklist.pop_back();
+        find_func_refs(node, [&](char* name, bool) {
+            auto iter = funcs.find(name);
+            if(iter != funcs.end() && live.insert(name).second)
+                worklist.push_back(iter->second);
+        });
+        set<char*, cstr_cmp> labels;
+        find_global_refs(node, labels);
+        for(auto label:labels) {
+            if(!live_vars.insert(label).second)
+                continue;
+            for(auto decl:decls[label])
+                for(auto init:dynamic_pointer_cast<DeclNode>(decl)->init_list)
+                    worklist.push_back(init);
+        }
+    }
+    ast.erase(remove_if(ast.begin(), ast.end(), [&](NodePtr node) {
+        if(is_static_decl(node))
+            return !live_vars.count(decl_label(node));
+        return node->kind == NK_FUNC_DEF && node->type->is_static() 
+            && !live.count(dynamic_pointer_cast<FuncDefNode>(node)->func_name);
+    }), ast.end());
+}
+
+struct SlotBlock {
+    int parent;
+    int depth;
+    vector<int> children;
+    vector<shared_ptr<LocalVarNode>> vars;
+};
+
+static int common_block(vector<SlotBlock>& blocks, int a, int b) {
+    if(a < 0) return b;
+    while(blocks[a].depth > blocks[b].depth) a = blocks[a].parent;
+    while(blocks[b].depth > blocks[a].depth) b = blocks[b].parent;
+    while(a != b) {
+        a = blocks[a].parent;
+        b = blocks[b].parent;
+    }
+    return a;
+}
+
+static void find_var_blocks(NodePtr node, int cur, vector<SlotBlock>& blocks, 
+    map<Node*, int>& decl_block, map<Node*, int>& ref_block) {
+    if(node->kind == NK_COMPOUND_STMT) {
+        blocks.push_back(SlotBlock{cur, blocks[cur].depth + 1, {}, {}});
+        blocks[cur].children.push_back(blocks.size() - 1);
+        cur = blocks.size() - 1;
+    }
+    else if(node->kind == NK_DECL) {
+        Node* var = dynamic_pointer_cast<DeclNode>(node)->var.get();
+        auto iter = decl_block.find(var);
+        decl_block[var] = common_block(blocks, iter == decl_block.end() ? -1 : iter->second, cur);
+    }
+    else if(node->kind == NK_LOCAL_VAR) {
+        auto iter = ref_block.find(node.get());
+        ref_block[node.get()] = common_block(blocks, iter == ref_block.end() ? -1 : iter->second, cur);
+    }
+    for_each_child(node, [&](NodePtr& child) { find_var_blocks(child, cur, blocks, decl_block, ref_block); });
+}
+
+// Lay out the variables of a block below offset, then the nested blocks below them.
+// Sibling blocks are never live at the same time, so they share the same slots.
+static int place_block(vector<SlotBlock>& blocks, int id, int offset) {
+    vector<shared_ptr<LocalVarNode>>& vars = blocks[id].vars;
+    stable_sort(vars.begin(), vars.end(), [](shared_ptr<LocalVarNode> x, shared_ptr<LocalVarNode> y) {
+        return x->type->align > y->type->align;
+    });
+    for(auto var:vars) {
+        int align = max(1, min(var->type->align, 8));
+        offset = -((var->type->size - offset + align - 1) / align * align);
+        var->slot = offset;
+    }
+    int low = offset;
+    for(int child:blocks[id].children) 
+        low = min(low, place_block(blocks, child, offset));
+    return low;
+}
+
+// A variable lives in the block that declares it, or in an enclosing block when it is 
+// used outside, as the declarations in the head of a for statement get their own block.
+// Temporaries have no declaration, they live in the innermost block containing all 
+// their uses, except compound literals, which are initialized only once and keep 
+// their own slot.
+void Optimizer::assign_stack_slots(shared_ptr<FuncDefNode> func) {
+    vector<SlotBlock> blocks(1, SlotBlock{-1, 0, {}, {}});
+    map<Node*, int> decl_block, ref_block;
+    if(func->body && optimize)
+        find_var_blocks(func->body, 0, blocks, decl_block, ref_block);
+    for(auto node:func->local_vars) {
+        shared_ptr<LocalVarNode> var = dynamic_pointer_cast<LocalVarNode>(node);
+        int id = 0;
+        if(decl_block.count(var.get())) 
+            id = ref_block.count(var.get()) ? 
+                common_block(blocks, decl_block[var.get()], ref_block[var.get()]) : decl_block[var.get()];
+        else if(var->init_list.empty() && ref_block.count(var.get())) 
+            id = ref_block[var.get()];
+        blocks[id].vars.push_back(var);
+    }
+    int low = place_block(blocks, 0, 0);
+    func->local_area = (-low + 7) / 8 * 8;
+}
+
+static NodePtr lvalue_root(NodePtr node);
+
+// The variable a pointer value is made from: the address of an object 
+// or an array decayed to a pointer, moved by pointer arithmetic
+static NodePtr pointer_root(NodePtr addr) {
+    for(;;) {
+        if(addr->kind == NK_ADDR)
+            return lvalue_root(dynamic_pointer_cast<UnaryOperNode>(addr)->operand);
+        if(addr->kind == NK_CONV || addr->kind == NK_CAST) {
+            addr = dynamic_pointer_cast<UnaryOperNode>(addr)->operand;
+            if(addr->type->kind == TK_ARRAY)
+                return lvalue_root(addr);
+        }
+        else if((addr->kind == '+' || addr->kind == '-') && addr->type->kind == TK_PTR
+            && dynamic_pointer_cast<BinaryOperNode>(addr))
+            addr = dynamic_pointer_cast<BinaryOperNode>(addr)->left;
+        else
+            return nullptr;
+    }
+}
+
+// The variable an lvalue lies in, through members and subscripts of arrays
+static NodePtr lvalue_root(NodePtr node) {
+    while(node->kind == NK_STRUCT_MEMBER) 
+        node = dynamic_pointer_cast<StructMemberNode>(node)->struc;
+    if(node->kind == NK_DEREF)
+        return pointer_root(dynamic_pointer_cast<UnaryOperNode>(node)->operand);
+    return node;
+}
+
+// The local whose address node takes, directly or by an array decaying to a pointer
+static Node* escaping_local(NodePtr node) {
+    NodePtr root;
+    if(node->kind == NK_ADDR)
+        root = lvalue_root(dynamic_pointer_cast<UnaryOperNode>(node)->operand);
+    else if(node->type && node->type->kind == TK_ARRAY && 
+        (node->kind == NK_LOCAL_VAR || node->kind == NK_STRUCT_MEMBER || node->kind == NK_DEREF))
+        root = lvalue_root(node);
+    return root && root->kind == NK_LOCAL_VAR ? root.get() : nullptr;
+}
+
+// Whether a pointer into the frame of the function may exist
+static bool has_local_addr(NodePtr node) {
+    if(escaping_local(node))
+        return true;
+    bool found = false;
+    for_each_child(node, [&](NodePtr& child) { found = found || has_local_addr(child); });
+    return found;
+}
+
+// The arguments must fit in registers, the stack arguments of the caller 
+// belong to its own caller and cannot be reused
+static bool is_tail_callable(FuncCallNode* call, Type* return_type) {
+    if(call->func_name && !strncmp(call->func_name, "__builtin_", 10))
+        return false;
+    if(!same_type(call->type, return_type) || call->type->kind == TK_STRUCT) 
+        return false;
+    int gprs = 0, xmms = 0;
+    for(auto arg:call->args) {
+        if(arg->type->kind == TK_STRUCT) 
+            return false;
+        if(arg->type->is_float_type() ? ++xmms > 8 : ++gprs > 6) 
+            return false;
+    }
+    return true;
+}
+
+// A call in tail position is replaced by a jump when the callee may not see the 
+// frame: the frame is gone by then, and so are the variadic register save area 
+// and any local whose address was taken.
+void Optimizer::mark_tail_calls(shared_ptr<FuncDefNode> func) {
+    FuncType* ftype = dynamic_cast<FuncType*>(func->type);
+    if(!func->body || ftype->has_var_param || has_local_addr(func->body)) 
+        return;
+    set<Node*> calls;
+    find_return_calls(func->body, calls);
+    for(auto node:calls) {
+        FuncCallNode* call = dynamic_cast<FuncCallNode*>(node);
+        call->is_tail_call = is_tail_callable(call, ftype->return_type);
+    }
+}
+
+struct LoopContext {
+    shared_ptr<FuncDefNode> func;
+    // locals whose address is taken somewhere in the function
+    set<Node*> addr_taken;
+    // number of jumps to each label in the function
+    map<char*, int, cstr_cmp> jumps;
+};
+
+// A loop in a statement list: list[head] is the label jumped back to from list[tail]
+struct Loop {
+    Loop(LoopContext& ctx, vector<NodePtr>& list, int head, int tail): 
+        ctx(ctx), list(list), head(head), tail(tail) {}
+
+    LoopContext& ctx;
+    vector<NodePtr>& list;
+    int head, tail;
+    // locals assigned in the loop
+    set<Node*> modified;
+    // whether the loop may store to memory other than locals
+    bool writes_memory = false;
+    // statements run once before entering the loop
+    vector<NodePtr> preheader;
+};
+
+// Value of a loop temporary and the temporary
+using LoopTemps = vector<pair<NodePtr, NodePtr>>;
+
+// An update of an induction variable by a constant, at list[index]
+struct Step {
+    vector<NodePtr>* list;
+    int index;
+    long long value;
+};
+
+static bool same_expr(NodePtr a, NodePtr b) {
+    if(a == b)
+        return true;
+    if(a->kind != b->kind || !a->type || !b->type || !a->type->is_compatible(b->type))
+        return false;
+    switch(a->kind) {
+    case NK_LITERAL: {
+        shared_ptr<IntNode> x = as_int_literal(a), y = as_int_literal(b);
+        return x && y && x->value == y->value;
+    }
+    case NK_GLOBAL_VAR:
+        return !strcmp(dynamic_pointer_cast<GlobalVarNode>(a)->global_label, 
+            dynamic_pointer_cast<GlobalVarNode>(b)->global_label);
+    case NK_LOCAL_VAR: case NK_FUNC_DESG:
+        return false;
+    case NK_STRUCT_MEMBER: {
+        shared_ptr<StructMemberNode> mx = dynamic_pointer_cast<StructMemberNode>(a);
+        shared_ptr<StructMemberNode> my = dynamic_pointer_cast<StructMemberNode>(b);
+        return mx->field_name && my->field_name && !strcmp(mx->field_name, my->field_name) 
+            && same_expr(mx->struc, my->struc);
+    }
+    }
+    shared_ptr<UnaryOperNode> ux = dynamic_pointer_cast<UnaryOperNode>(a);
+    shared_ptr<UnaryOperNode> uy = dynamic_pointer_cast<UnaryOperNode>(b);
+    if(ux && uy)
+        return same_expr(ux->operand, uy->operand);
+    shared_ptr<BinaryOperNode> bx = dynamic_pointer_cast<BinaryOperNode>(a);
+    shared_ptr<BinaryOperNode> by = dynamic_pointer_cast<BinaryOperNode>(b);
+    return bx && by && same_expr(bx->left, by->left) && same_expr(bx->right, by->right);
+}
+
+static void count_jumps(NodePtr node, map<char*, int, cstr_cmp>& jumps) {
+    if(node->kind == NK_JUMP) {
+        jumps[dynamic_pointer_cast<JumpNode>(node)->normal_label]++;
+    }
+    else if(node->kind == NK_JUMP_TABLE) {
+        shared_ptr<JumpTableNode> table = dynamic_pointer_cast<JumpTableNode>(node);
+        for(auto label:table->labels) 
+            jumps[label]++;
+        jumps[table->default_label]++;
+    }
+    for_each_child(node, [&](NodePtr& child) { count_jumps(child, jumps); });
+}
+
+static void find_labels(NodePtr node, vector<char*>& labels) {
+    if(node->kind == NK_LABEL)
+        labels.push_back(dynamic_pointer_cast<LabelNode>(node)->normal_label);
+    for_each_child(node, [&](NodePtr& child) { find_labels(child, labels); });
+}
+
+// Locals that may be accessed through a pointer. Arrays are always in memory, 
+// a decayed array only counts for the object containing it.
+static void find_addr_taken(NodePtr node, set<Node*>& vars) {
+    Node* var = escaping_local(node);
+    if(var && (node->kind == NK_ADDR || var->type->kind != TK_ARRAY))
+        vars.insert(var);
+    for_each_child(node, [&](NodePtr& child) { find_addr_taken(child, vars); });
+}
+
+// goto label or if(cond) goto label
+static bool is_back_edge(NodePtr node, char* label) {
+    if(node->kind == NK_IF) {
+        shared_ptr<IfNode> stmt = dynamic_pointer_cast<IfNode>(node);
+        if(stmt->els || !stmt->then)
+            return false;
+        node = stmt->then;
+    }
+    return node->kind == NK_JUMP && !strcmp(dynamic_pointer_cast<JumpNode>(node)->normal_label, label);
+}
+
+// The loop must be entered by falling through the label, 
+// so that the preheader is always run first
+static bool has_single_entry(Loop& loop) {
+    map<char*, int, cstr_cmp> jumps;
+    vector<char*> labels(1, dynamic_pointer_cast<LabelNode>(loop.list[loop.head])->normal_label);
+    for(int i = loop.head + 1; i <= loop.tail; ++i) {
+        count_jumps(loop.list[i], jumps);
+        find_labels(loop.list[i], labels);
+    }
+    for(auto label:labels) {
+        if(jumps[label] != loop.ctx.jumps[label])
+            return false;
+    }
+    return true;
+}
+
+static void scan_loop_body(NodePtr node, Loop& loop) {
+    NodePtr target;
+    switch(node->kind) {
+    case NK_FUNC_CALL: case NK_FUNCPTR_CALL:
+        loop.writes_memory = true;
+        break;
+    case '=':
+        if(shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node))
+            target = expr->left;
+        break;
+    case NK_PRE_INC: case NK_PRE_DEC: case NK_POST_INC: case NK_POST_DEC:
+        target = dynamic_pointer_cast<UnaryOperNode>(node)->operand;
+        break;
+    case NK_DECL:
+        target = dynamic_pointer_cast<DeclNode>(node)->var;
+        if(target->kind != NK_LOCAL_VAR)
+            target = nullptr;
+        break;
+    }
+    if(target && target->kind == NK_LOCAL_VAR)
+        loop.modified.insert(target.get());
+    else if(target)
+        loop.writes_memory = true;
+    for_each_child(node, [&](NodePtr& child) { scan_loop_body(child, loop); });
+}
+
+// Whether the value of the expression is the same in every iteration.
+// Division is only invariant by a constant, it would trap otherwise.
+static bool is_invariant(NodePtr node, Loop& loop) {
+    if(node->type && has_qualifier(node->type, KW_VOLATILE))
+        return false;
+    switch(node->kind) {
+    case NK_LITERAL: case NK_FUNC_DESG:
+        return true;
+    case NK_GLOBAL_VAR:
+        return node->type->kind == TK_ARRAY || !loop.writes_memory;
+    case NK_LOCAL_VAR: {
+        if(!dynamic_pointer_cast<LocalVarNode>(node)->init_list.empty())
+            return false;
+        if(node->type->kind == TK_ARRAY)
+            return true;
+        return is_scalar_value(node->type) && !loop.modified.count(node.get()) 
+            && (!loop.writes_memory || !loop.ctx.addr_taken.count(node.get()));
+    }
+    case NK_ADDR: {
+        NodePtr operand = dynamic_pointer_cast<UnaryOperNode>(node)->operand;
+        if(operand->kind == NK_LOCAL_VAR)
+            return dynamic_pointer_cast<LocalVarNode>(operand)->init_list.empty();
+        return operand->kind == NK_GLOBAL_VAR || operand->kind == NK_FUNC_DESG;
+    }
+    case NK_DEREF:
+        return node->type->kind == TK_ARRAY && 
+            is_invariant(dynamic_pointer_cast<UnaryOperNode>(node)->operand, loop);
+    case NK_CONV: case NK_CAST: case '~': case '!':
+        return is_invariant(dynamic_pointer_cast<UnaryOperNode>(node)->operand, loop);
+    case '/': case '%': {
+        shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node);
+        shared_ptr<IntNode> divisor = as_int_literal(expr->right);
+        return divisor && divisor->value != 0 && divisor->value != -1 && is_invariant(expr->left, loop);
+    }
+    case '+': case '-': case '*': case '&': case '|': case '^':
+    case '<': case P_LE: case P_EQ: case P_NE: case P_LOGAND: case P_LOGOR:
+    case NK_SAL: case NK_SAR: case NK_SHR: {
+        shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node);
+        return expr && is_invariant(expr->left, loop) && is_invariant(expr->right, loop);
+    }
+    default:
+        return false;
+    }
+}
+
+// Temporary holding the value of expr, computed in the preheader
+static NodePtr loop_temp(NodePtr expr, Loop& loop, LoopTemps& temps) {
+    for(auto& temp:temps) {
+        if(same_expr(temp.first, expr))
+            return temp.second;
+    }
+    TokenPtr tok = expr->first_token;
+    shared_ptr<LocalVarNode> var = arena_make<LocalVarNode>(tok, expr->type, make_tmpname());
+    loop.ctx.func->local_vars.push_back(var);
+    loop.preheader.push_back(make_binary_oper_node(tok, '=', expr->type, var, expr));
+    temps.push_back(make_pair(expr, var));
+    return var;
+}
+
+static bool has_binop(NodePtr node) {
+    if(dynamic_pointer_cast<BinaryOperNode>(node))
+        return true;
+    bool found = false;
+    for_each_child(node, [&](NodePtr& child) { found = found || has_binop(child); });
+    return found;
+}
+
+static void hoist_invariants(NodePtr& node, Loop& loop, LoopTemps& temps) {
+    if(node->type && is_scalar_value(node->type) && has_binop(node) && is_invariant(node, loop)) {
+        node = loop_temp(node, loop, temps);
+        return;
+    }
+    for_each_child(node, [&](NodePtr& child) { hoist_invariants(child, loop, temps); });
+}
+
+// i++, ++i, i--, --i, i += c and i -= c
+static Node* get_step(NodePtr stmt, long long& value) {
+    switch(stmt->kind) {
+    case NK_PRE_INC: case NK_POST_INC:
+        value = 1;
+        return dynamic_pointer_cast<UnaryOperNode>(stmt)->operand.get();
+    case NK_PRE_DEC: case NK_POST_DEC:
+        value = -1;
+        return dynamic_pointer_cast<UnaryOperNode>(stmt)->operand.get();
+    case '=': {
+        shared_ptr<BinaryOperNode> assign = dynamic_pointer_cast<BinaryOperNode>(stmt);
+        shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(assign->right);
+        if(!expr || (expr->kind != '+' && expr->kind != '-') || expr->left != assign->left)
+            return nullptr;
+        shared_ptr<IntNode> literal = as_int_literal(expr->right);
+        if(!literal)
+            return nullptr;
+        value = expr->kind == '+' ? literal->value : -literal->value;
+        return assign->left.get();
+    }
+    default:
+        return nullptr;
+    }
+}
+
+// Updates of locals by a constant at statement level, 
+// where another statement may be added after them
+static void find_steps(vector<NodePtr>& list, int from, int to, vector<pair<Node*, vector<Step>>>& steps) {
+    for(int i = from; i <= to; ++i) {
+        NodePtr stmt = list[i];
+        if(!stmt) 
+            continue;
+        long long value;
+        Node* var = get_step(stmt, value);
+        if(var && var->kind == NK_LOCAL_VAR) {
+            auto iter = find_if(steps.begin(), steps.end(), 
+                [&](pair<Node*, vector<Step>>& p) { return p.first == var; });
+            if(iter == steps.end())
+                iter = steps.insert(steps.end(), make_pair(var, vector<Step>()));
+            iter->second.push_back(Step{&list, i, value});
+            continue;
+        }
+        vector<NodePtr> blocks;
+        if(stmt->kind == NK_COMPOUND_STMT) {
+            blocks.push_back(stmt);
+        }
+        else if(stmt->kind == NK_IF) {
+            blocks.push_back(dynamic_pointer_cast<IfNode>(stmt)->then);
+            blocks.push_back(dynamic_pointer_cast<IfNode>(stmt)->els);
+        }
+        for(auto block:blocks) {
+            if(block && block->kind == NK_COMPOUND_STMT) {
+                vector<NodePtr>& body = dynamic_pointer_cast<CompoundStmtNode>(block)->list;
+                find_steps(body, 0, (int)body.size() - 1, steps);
+            }
+        }
+    }
+}
+
+static int count_modifications(NodePtr node, Node* var) {
+    int count = 0;
+    switch(node->kind) {
+    case '=': 
+        if(shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node))
+            count += expr->left.get() == var;
+        break;
+    case NK_ADDR: case NK_PRE_INC: case NK_PRE_DEC: case NK_POST_INC: case NK_POST_DEC:
+        count += dynamic_pointer_cast<UnaryOperNode>(node)->operand.get() == var;
+        break;
+    case NK_DECL:
+        count += dynamic_pointer_cast<DeclNode>(node)->var.get() == var;
+        break;
+    }
+    for_each_child(node, [&](NodePtr& child) { count += count_modifications(child, var); });
+    return count;
+}
+
+// base + i, base + (i + c), base + (i - c) and base + (e + i) with base, c and e invariant
+static bool is_iv_address(NodePtr node, Node* var, Loop& loop) {
+    if(node->kind != '+' || !node->type || node->type->kind != TK_PTR)
+        return false;
+    shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node);
+    if(!expr || !is_invariant(expr->left, loop))
+        return false;
+    if(expr->right.get() == var)
+        return true;
+    shared_ptr<BinaryOperNode> index = dynamic_pointer_cast<BinaryOperNode>(expr->right);
+    if(!index || (index->kind != '+' && index->kind != '-'))
+        return false;
+    if(index->left.get() == var)
+        return is_invariant(index->right, loop);
+    return index->kind == '+' && index->right.get() == var && is_invariant(index->left, loop);
+}
+
+static void reduce_iv_uses(NodePtr& node, Node* var, Loop& loop, LoopTemps& ptrs) {
+    if(is_iv_address(node, var, loop)) {
+        node = loop_temp(node, loop, ptrs);
+        return;
+    }
+    for_each_child(node, [&](NodePtr& child) { reduce_iv_uses(child, var, loop, ptrs); });
+}
+
+static bool is_iv_type(Type* type) {
+    if(!type->is_int_type() || type->kind == TK_BOOL || type->bitsize > 0 || has_qualifier(type, KW_VOLATILE))
+        return false;
+    return type->size == 8 || (type->size == 4 && !type->is_unsigned);
+}
+
+// Strength reduction: an address base + i computed from an induction variable i
+// becomes a pointer set in the preheader and advanced after each update of i. 
+// int i is not converted to a wider type, since its overflow is undefined.
+static void reduce_induction_vars(Loop& loop) {
+    vector<pair<Node*, vector<Step>>> steps;
+    find_steps(loop.list, loop.head + 1, loop.tail, steps);
+    for(auto& iv:steps) {
+        Node* var = iv.first;
+        if(!is_iv_type(var->type) || loop.ctx.addr_taken.count(var))
+            continue;
+        int count = 0;
+        for(int i = loop.head + 1; i <= loop.tail; ++i) 
+            count += count_modifications(loop.list[i], var);
+        if(count != (int)iv.second.size())
+            continue;
+        LoopTemps ptrs;
+        for(int i = loop.head + 1; i <= loop.tail; ++i) 
+            reduce_iv_uses(loop.list[i], var, loop, ptrs);
+        if(ptrs.empty())
+            continue;
+        for(auto step:iv.second) {
+            NodePtr stmt = (*step.list)[step.index];
+            TokenPtr tok = stmt->first_token;
+            vector<NodePtr> list(1, stmt);
+            for(auto ptr:ptrs) {
+                NodePtr p = ptr.second;
+                NodePtr next = make_binary_oper_node(tok, '+', p->type, p, make_int_node(tok, type_long, step.value));
+                list.push_back(make_binary_oper_node(tok, '=', p->type, p, next));
+                loop.modified.insert(p.get());
+            }
+            (*step.list)[step.index] = make_compound_stmt_node(tok, list);
+        }
+    }
+}
+
+// Element types of which an SSE2 register holds 16 bytes
+static bool is_vector_elem(Type* type) {
+    if(type->bitsize > 0 || has_qualifier(type, KW_VOLATILE))
+        return false;
+    if(type->kind == TK_FLOAT || type->kind == TK_DOUBLE)
+        return true;
+    return type->is_int_type() && type->kind != TK_BOOL;
+}
+
+static int add_vector_operand(vector<NodePtr>& operands, NodePtr node) {
+    for(size_t i = 0; i < operands.size(); ++i) {
+        if(same_expr(operands[i], node))
+            return i;
+    }
+    operands.push_back(node);
+    return operands.size() - 1;
+}
+
+// base of base[var] with base invariant
+static NodePtr vector_elem_base(NodePtr node, Node* var, Loop& loop) {
+    if(node->kind != NK_DEREF || !is_vector_elem(node->type))
+        return nullptr;
+    NodePtr addr = dynamic_pointer_cast<UnaryOperNode>(node)->operand;
+    shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(addr);
+    if(!expr || addr->kind != '+' || addr->type->kind != TK_PTR || expr->right.get() != var)
+        return nullptr;
+    return is_invariant(expr->left, loop) ? expr->left : nullptr;
+}
+
+// Append the postfix code of node, evaluated in xmm<depth>. Floating point operations 
+// must be exactly those of the element type, integer operations only need to be 
+// exact modulo the element size.
+static bool compile_vector_expr(NodePtr node, VectorLoopNode* vec, Loop& loop, int depth) {
+    Type* elem = vec->elem_type;
+    if(depth >= 6)
+        return false;
+    if(NodePtr base = vector_elem_base(node, vec->var.get(), loop)) {
+        if(elem->is_float_type() ? node->type->kind != elem->kind : 
+            !node->type->is_int_type() || node->type->size != elem->size)
+            return false;
+        vec->code.push_back(make_pair((int)VectorLoopNode::VEC_LOAD, add_vector_operand(vec->arrays, base)));
+        return true;
+    }
+    if(is_invariant(node, loop)) {
+        if(elem->is_float_type() ? node->type->kind != elem->kind : !node->type->is_int_type())
+            return false;
+        vec->code.push_back(make_pair((int)VectorLoopNode::VEC_SCALAR, add_vector_operand(vec->scalars, node)));
+        return true;
+    }
+    if(elem->is_float_type() ? node->type->kind != elem->kind : 
+        !node->type->is_int_type() || node->type->size < elem->size)
+        return false;
+    if(node->kind == NK_CONV) {
+        NodePtr operand = dynamic_pointer_cast<UnaryOperNode>(node)->operand;
+        return elem->is_int_type() && operand->type->is_int_type() && 
+            compile_vector_expr(operand, vec, loop, depth);
+    }
+    shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node);
+    if(!expr) 
+        return false;
+    switch(node->kind) {
+    case '+': case '-':
+        break;
+    case '*':
+        if(elem->is_int_type() && elem->size != 2 && elem->size != 4)
+            return false;
+        break;
+    case '/':
+        if(!elem->is_float_type())
+            return false;
+        break;
+    case '&': case '|': case '^':
+        if(elem->is_float_type())
+            return false;
+        break;
+    default:
+        return false;
+    }
+    if(!compile_vector_expr(expr->left, vec, loop, depth) || 
+        !compile_vector_expr(expr->right, vec, loop, depth + 1))
+        return false;
+    vec->code.push_back(make_pair(node->kind, 0));
+    return true;
+}
+
+static bool is_restrict(NodePtr base) {
+    return base->kind == NK_LOCAL_VAR && has_qualifier(base->type, KW_RESTRICT);
+}
+
+// The array variable whose address base is
+static NodePtr array_object(NodePtr base) {
+    if(base->kind != NK_CONV)
+        return nullptr;
+    NodePtr var = dynamic_pointer_cast<UnaryOperNode>(base)->operand;
+    if(var->type->kind != TK_ARRAY || (var->kind != NK_LOCAL_VAR && var->kind != NK_GLOBAL_VAR))
+        return nullptr;
+    return var;
+}
+
+static bool may_overlap(NodePtr dst, NodePtr src) {
+    if(same_expr(dst, src) || is_restrict(dst) || is_restrict(src))
+        return false;
+    NodePtr x = array_object(dst), y = array_object(src);
+    if(!x || !y)
+        return true;
+    if(x->kind == NK_GLOBAL_VAR && y->kind == NK_GLOBAL_VAR)
+        return !strcmp(dynamic_pointer_cast<GlobalVarNode>(x)->global_label, 
+            dynamic_pointer_cast<GlobalVarNode>(y)->global_label);
+    return x == y;
+}
+
+// for(...; i < n; i++) a[i] = expr, or s += expr, with the lowered form
+// [begin: if(i < n) else goto end, body, next:, i++, goto begin]
+static void vectorize_loop(Loop& loop) {
+    vector<NodePtr>& list = loop.list;
+    int head = loop.head;
+    if(loop.tail != head + 5 || list[head + 1]->kind != NK_IF || list[head + 3]->kind != NK_LABEL)
+        return;
+    shared_ptr<IfNode> test = dynamic_pointer_cast<IfNode>(list[head + 1]);
+    if(test->then || !test->els || test->els->kind != NK_JUMP || test->cond->kind != '<')
+        return;
+    shared_ptr<BinaryOperNode> cond = dynamic_pointer_cast<BinaryOperNode>(test->cond);
+    NodePtr var = cond->left;
+    long long step;
+    if(var->kind != NK_LOCAL_VAR || !is_iv_type(var->type) || var->type->is_unsigned || 
+        loop.ctx.addr_taken.count(var.get()) || !is_invariant(cond->right, loop))
+        return;
+    if(get_step(list[head + 4], step) != var.get() || step != 1)
+        return;
+    int count = 0;
+    for(int i = head + 1; i <= loop.tail; ++i) 
+        count += count_modifications(list[i], var.get());
+    if(count != 1)
+        return;
+
+    NodePtr body = list[head + 2];
+    while(body->kind == NK_COMPOUND_STMT && dynamic_pointer_cast<CompoundStmtNode>(body)->list.size() == 1)
+        body = dynamic_pointer_cast<CompoundStmtNode>(body)->list[0];
+    shared_ptr<BinaryOperNode> assign = dynamic_pointer_cast<BinaryOperNode>(body);
+    if(body->kind != '=' || !assign)
+        return;
+    shared_ptr<VectorLoopNode> vec;
+    NodePtr value;
+    if(NodePtr base = vector_elem_base(assign->left, var.get(), loop)) {
+        vec = make_vector_loop_node(body->first_token, assign->left->type, var, cond->right);
+        vec->dst = base;
+        value = assign->right;
+    }
+    else {
+        // the sum of floating point values depends on the order of the additions
+        NodePtr acc = assign->left;
+        shared_ptr<BinaryOperNode> sum = dynamic_pointer_cast<BinaryOperNode>(assign->right);
+        if(acc->kind != NK_LOCAL_VAR || acc == var || !is_vector_elem(acc->type) || !acc->type->is_int_type())
+            return;
+        if(!dynamic_pointer_cast<LocalVarNode>(acc)->init_list.empty() || loop.ctx.addr_taken.count(acc.get()))
+            return;
+        if(!sum || sum->kind != '+' || sum->left != acc || count_modifications(body, acc.get()) != 1)
+            return;
+        vec = make_vector_loop_node(body->first_token, acc->type, var, cond->right);
+        vec->acc = acc;
+        value = sum->right;
+    }
+    if(!compile_vector_expr(value, vec.get(), loop, 0))
+        return;
+    if(vec->arrays.size() + (vec->dst ? 1 : 0) > 6 || vec->scalars.size() > 6)
+        return;
+    vec->check_alias = false;
+    for(auto array:vec->arrays) {
+        if(vec->dst && may_overlap(vec->dst, array))
+            vec->check_alias = true;
+    }
+    loop.preheader.push_back(vec);
+}
+
+static void optimize_loop(Loop& loop) {
+    for(int i = loop.head + 1; i <= loop.tail; ++i)
+        scan_loop_body(loop.list[i], loop);
+    vectorize_loop(loop);
+    reduce_induction_vars(loop);
+    LoopTemps temps;
+    for(int i = loop.head + 1; i <= loop.tail; ++i)
+        hoist_invariants(loop.list[i], loop, temps);
+    loop.list.insert(loop.list.begin() + loop.head, loop.preheader.begin(), loop.preheader.end());
+}
+
+// Inner loops first, so that what they hoist may be hoisted again by the outer loops
+static void find_loops(NodePtr node, LoopContext& ctx) {
+    for_each_child(node, [&](NodePtr& child) { find_loops(child, ctx); });
+    if(node->kind != NK_COMPOUND_STMT)
+        return;
+    vector<NodePtr>& list = dynamic_pointer_cast<CompoundStmtNode>(node)->list;
+    for(int head = (int)list.size() - 1; head >= 0; --head) {
+        if(!list[head] || list[head]->kind != NK_LABEL)
+            continue;
+        char* label = dynamic_pointer_cast<LabelNode>(list[head])->normal_label;
+        int tail = list.size() - 1;
+        while(tail > head && !(list[tail] && is_back_edge(list[tail], label)))
+            --tail;
+        if(tail == head)
+            continue;
+        Loop loop(ctx, list, head, tail);
+        if(has_single_entry(loop))
+            optimize_loop(loop);
+    }
+}
+
+// Loops are found in the lowered form: a label, and a jump back to it later in 
+// the same statement list. Loop-invariant expressions are computed once before 
+// the label, and addresses indexed by an induction variable are strength reduced.
+// Simple counted loops over arrays first get a vectorized copy before the label.
+void Optimizer::optimize_loops(shared_ptr<FuncDefNode> func) {
+    if(!func->body || has_label_addr(func->body))
+        return;
+    LoopContext ctx;
+    ctx.func = func;
+    find_addr_taken(func->body, ctx.addr_taken);
+    count_jumps(func->body, ctx.jumps);
+    find_loops(func->body, ctx);
+}
+
+// ------------------------------ dead code elimination ------------------------------
+
+using LabelSet = set<char*, cstr_cmp>;
+
+static bool is_stmt(NodePtr node) {
+    switch(node->kind) {
+    case NK_COMPOUND_STMT: case NK_IF: case NK_LABEL: case NK_JUMP: case NK_JUMP_TABLE: 
+    case NK_RETURN: case NK_DECL: case NK_VECTOR_LOOP: case NK_COMPUTED_GOTO:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Labels or jumps inside an expression, i.e. a statement expression
+static bool has_control(NodePtr node) {
+    switch(node->kind) {
+    case NK_LABEL: case NK_JUMP: case NK_JUMP_TABLE: case NK_RETURN: case NK_COMPUTED_GOTO:
+        return true;
+    }
+    bool found = false;
+    for_each_child(node, [&](NodePtr& child) { found = found || has_control(child); });
+    return found;
+}
+
+static bool has_live_label(NodePtr node, LabelSet& live) {
+    if(node->kind == NK_LABEL && live.count(dynamic_pointer_cast<LabelNode>(node)->normal_label))
+        return true;
+    bool found = false;
+    for_each_child(node, [&](NodePtr& child) { found = found || has_live_label(child, live); });
+    return found;
+}
+
+static void mark_jump_targets(NodePtr node, LabelSet& live) {
+    if(node->kind == NK_JUMP) {
+        live.insert(dynamic_pointer_cast<JumpNode>(node)->normal_label);
+    }
+    else if(node->kind == NK_JUMP_TABLE) {
+        shared_ptr<JumpTableNode> table = dynamic_pointer_cast<JumpTableNode>(node);
+        live.insert(table->labels.begin(), table->labels.end());
+        live.insert(table->default_label);
+    }
+    for_each_child(node, [&](NodePtr& child) { mark_jump_targets(child, live); });
+}
+
+// Which arms of an if statement may run: 1 for then, 2 for else
+static int if_arms(shared_ptr<IfNode> stmt) {
+    shared_ptr<IntNode> cond = as_int_literal(stmt->cond);
+    if(!cond)
+        return 3;
+    return cond->value ? 1 : 2;
+}
+
+// Whether control may reach the end of node, given whether it may reach its start.
+// Jumps in reachable code make their targets live. Expressions containing control 
+// flow are assumed to jump anywhere and to be entered from anywhere.
+static bool mark_reachable(NodePtr node, bool reachable, LabelSet& live) {
+    switch(node->kind) {
+    case NK_COMPOUND_STMT:
+        for(auto stmt:dynamic_pointer_cast<CompoundStmtNode>(node)->list)
+            reachable = mark_reachable(stmt, reachable, live);
+        return reachable;
+    case NK_IF: {
+        shared_ptr<IfNode> stmt = dynamic_pointer_cast<IfNode>(node);
+        reachable = mark_reachable(stmt->cond, reachable, live);
+        int arms = if_arms(stmt);
+        bool then_end = reachable && (arms & 1), els_end = reachable && (arms & 2);
+        if(stmt->then)
+            then_end = mark_reachable(stmt->then, then_end, live);
+        if(stmt->els)
+            els_end = mark_reachable(stmt->els, els_end, live);
+        return then_end || els_end;
+    }
+    case NK_LABEL:
+        return reachable || live.count(dynamic_pointer_cast<LabelNode>(node)->normal_label);
+    case NK_JUMP: case NK_JUMP_TABLE:
+        if(reachable)
+            mark_jump_targets(node, live);
+        return false;
+    case NK_RETURN: {
+        NodePtr value = dynamic_pointer_cast<ReturnNode>(node)->return_val;
+        if(value)
+            mark_reachable(value, reachable, live);
+        return false;
+    }
+    }
+    if(!has_control(node))
+        return reachable;
+    mark_jump_targets(node, live);
+    return true;
+}
+
+// Replace jumps to a label followed by another jump with a jump to its target
+static void find_jump_forwards(NodePtr node, map<char*, char*, cstr_cmp>& forwards) {
+    if(node->kind == NK_COMPOUND_STMT) {
+        vector<NodePtr>& list = dynamic_pointer_cast<CompoundStmtNode>(node)->list;
+        for(size_t i = 0; i < list.size(); ++i) {
+            if(list[i]->kind != NK_LABEL)
+                continue;
+            size_t j = i + 1;
+            while(j < list.size() && (list[j]->kind == NK_LABEL || (list[j]->kind == NK_COMPOUND_STMT 
+                && dynamic_pointer_cast<CompoundStmtNode>(list[j])->list.empty())))
+                ++j;
+            if(j < list.size() && list[j]->kind == NK_JUMP)
+                forwards[dynamic_pointer_cast<LabelNode>(list[i])->normal_label] = 
+                    dynamic_pointer_cast<JumpNode>(list[j])->normal_label;
+        }
+    }
+    for_each_child(node, [&](NodePtr& child) { find_jump_forwards(child, forwards); });
+}
+
+static char* thread_label(char* label, map<char*, char*, cstr_cmp>& forwards) {
+    // a chain longer than the number of labels is a cycle
+    for(size_t i = 0; i < forwards.size(); ++i) {
+        auto iter = forwards.find(label);
+        if(iter == forwards.end())
+            return label;
+        label = iter->second;
+    }
+    return label;
+}
+
+static void thread_jumps(NodePtr node, map<char*, char*, cstr_cmp>& forwards) {
+    if(node->kind == NK_JUMP) {
+        shared_ptr<JumpNode> jump = dynamic_pointer_cast<JumpNode>(node);
+        jump->normal_label = thread_label(jump->normal_label, forwards);
+    }
+    else if(node->kind == NK_JUMP_TABLE) {
+        shared_ptr<JumpTableNode> table = dynamic_pointer_cast<JumpTableNode>(node);
+        for(auto& label:table->labels)
+            label = thread_label(label, forwards);
+        table->default_label = thread_label(table->default_label, forwards);
+    }
+    for_each_child(node, [&](NodePtr& child) { thread_jumps(child, forwards); });
+}
+
+// Locals of which the value is never used, only assigned
+static void find_read_vars(NodePtr node, set<Node*>& vars) {
+    if(node->kind == NK_LOCAL_VAR) {
+        vars.insert(node.get());
+    }
+    else if(node->kind == '=' && dynamic_pointer_cast<BinaryOperNode>(node)) {
+        shared_ptr<BinaryOperNode> assign = dynamic_pointer_cast<BinaryOperNode>(node);
+        if(assign->left->kind != NK_LOCAL_VAR)
+            find_read_vars(assign->left, vars);
+        find_read_vars(assign->right, vars);
+        return;
+    }
+    else if(node->kind == NK_DECL) {
+        for(auto init:dynamic_pointer_cast<DeclNode>(node)->init_list)
+            find_read_vars(init, vars);
+        return;
+    }
+    for_each_child(node, [&](NodePtr& child) { find_read_vars(child, vars); });
+}
+
+static bool reads_var(NodePtr node, Node* var) {
+    set<Node*> vars;
+    find_read_vars(node, vars);
+    return vars.count(var) > 0;
+}
+
+// Loads through pointers and calls may read any local whose address was taken
+static bool reads_memory(NodePtr node) {
+    if(node->kind == NK_DEREF || node->kind == NK_FUNC_CALL || node->kind == NK_FUNCPTR_CALL)
+        return true;
+    bool found = false;
+    for_each_child(node, [&](NodePtr& child) { found = found || reads_memory(child); });
+    return found;
+}
+
+// The local assigned by a statement var = value, where the store may be removed
+static Node* stored_var(NodePtr stmt) {
+    shared_ptr<BinaryOperNode> assign = dynamic_pointer_cast<BinaryOperNode>(stmt);
+    if(stmt->kind != '=' || !assign || assign->left->kind != NK_LOCAL_VAR)
+        return nullptr;
+    Type* type = assign->left->type;
+    if(!is_scalar_value(type) || has_qualifier(type, KW_VOLATILE) || 
+        !dynamic_pointer_cast<LocalVarNode>(assign->left)->init_list.empty())
+        return nullptr;
+    return assign->left.get();
+}
+
+struct DceContext {
+    LabelSet live;
+    set<Node*> read_vars;
+    set<Node*> addr_taken;
+};
+
+// Whether list[i] stores to a local which is assigned again before being read, 
+// with no control flow in between
+static bool is_overwritten(vector<NodePtr>& list, size_t i, Node* var) {
+    for(size_t j = i + 1; j < list.size(); ++j) {
+        if(is_stmt(list[j]) || has_control(list[j]))
+            return false;
+        if(stored_var(list[j]) == var) {
+            NodePtr value = dynamic_pointer_cast<BinaryOperNode>(list[j])->right;
+            return !reads_var(value, var) && !reads_memory(value);
+        }
+        if(reads_var(list[j], var) || reads_memory(list[j]))
+            return false;
+    }
+    return false;
+}
+
+// A jump to the label that follows it, possibly past other labels, falls through instead
+static void remove_jump_to_next(vector<NodePtr>& list, char* label) {
+    for(size_t i = list.size(); i-- > 0; ) {
+        if(list[i]->kind == NK_LABEL)
+            continue;
+        if(list[i]->kind == NK_JUMP && !strcmp(dynamic_pointer_cast<JumpNode>(list[i])->normal_label, label))
+            list.erase(list.begin() + i);
+        return;
+    }
+}
+
+static void append_stmt(vector<NodePtr>& list, NodePtr stmt) {
+    if(stmt->kind == NK_LABEL)
+        remove_jump_to_next(list, dynamic_pointer_cast<LabelNode>(stmt)->normal_label);
+    list.push_back(stmt);
+}
+
+static bool has_decl(NodePtr node) {
+    for(auto stmt:dynamic_pointer_cast<CompoundStmtNode>(node)->list)
+        if(stmt->kind == NK_DECL)
+            return true;
+    return false;
+}
+
+static bool remove_dead_code(NodePtr& node, bool reachable, DceContext& ctx);
+
+// Statement expressions are cleaned like blocks, except for the value at their end
+static void clean_stmt_exprs(NodePtr node, DceContext& ctx) {
+    if(node->kind != NK_COMPOUND_STMT) {
+        for_each_child(node, [&](NodePtr& child) { clean_stmt_exprs(child, ctx); });
+        return;
+    }
+    vector<NodePtr>& list = dynamic_pointer_cast<CompoundStmtNode>(node)->list;
+    if(list.empty() || !node->type || node->type->kind == TK_VOID) {
+        remove_dead_code(node, true, ctx);
+        return;
+    }
+    NodePtr value = list.back();
+    list.pop_back();
+    remove_dead_code(node, true, ctx);
+    clean_stmt_exprs(value, ctx);
+    list.push_back(value);
+}
+
+// Remove the statements of which the start is unreachable, the labels never jumped to,
+// the jumps to the next statement, the stores never read and the expressions 
+// without side effects. Blocks without declarations are merged into the enclosing list.
+static bool remove_dead_code(NodePtr& node, bool reachable, DceContext& ctx) {
+    switch(node->kind) {
+    case NK_COMPOUND_STMT: {
+        vector<NodePtr>& list = dynamic_pointer_cast<CompoundStmtNode>(node)->list;
+        vector<NodePtr> result;
+        for(size_t i = 0; i < list.size(); ++i) {
+            NodePtr stmt = list[i];
+            if(!reachable && !has_live_label(stmt, ctx.live))
+                continue;
+            if(stmt->kind == NK_LABEL && !ctx.live.count(dynamic_pointer_cast<LabelNode>(stmt)->normal_label))
+                continue;
+            Node* var = stored_var(stmt);
+            if(var && !ctx.addr_taken.count(var) && 
+                (!ctx.read_vars.count(var) || is_overwritten(list, i, var)))
+                stmt = dynamic_pointer_cast<BinaryOperNode>(stmt)->right;
+            if(!is_stmt(stmt) && is_pure(stmt) && !has_control(stmt))
+                continue;
+            reachable = remove_dead_code(stmt, reachable, ctx);
+            if(stmt->kind == NK_COMPOUND_STMT && !has_decl(stmt)) {
+                for(auto child:dynamic_pointer_cast<CompoundStmtNode>(stmt)->list)
+                    append_stmt(result, child);
+            }
+            else {
+                append_stmt(result, stmt);
+            }
+        }
+        list = result;
+        return reachable;
+    }
+    case NK_IF: {
+        shared_ptr<IfNode> stmt = dynamic_pointer_cast<IfNode>(node);
+        reachable = mark_reachable(stmt->cond, reachable, ctx.live);
+        int arms = if_arms(stmt);
+        if(arms != 3) {
+            NodePtr live = arms == 1 ? stmt->then : stmt->els;
+            NodePtr dead = arms == 1 ? stmt->els : stmt->then;
+            if(!dead || !has_live_label(dead, ctx.live)) {
+                node = live ? live : make_compound_stmt_node(node->first_token, vector<NodePtr>());
+                return remove_dead_code(node, reachable, ctx);
+            }
+        }
+        bool then_end = reachable && (arms & 1), els_end = reachable && (arms & 2);
+        if(stmt->then)
+            then_end = remove_dead_code(stmt->then, then_end, ctx);
+        if(stmt->els)
+            els_end = remove_dead_code(stmt->els, els_end, ctx);
+        return then_end || els_end;
+    }
+    default:
+        clean_stmt_exprs(node, ctx);
+        return mark_reachable(node, reachable, ctx.live);
+    }
+}
+
+static void find_local_refs(NodePtr node, set<Node*>& vars) {
+    if(node->kind == NK_LOCAL_VAR)
+        vars.insert(node.get());
+    for_each_child(node, [&](NodePtr& child) { find_local_refs(child, vars); });
+}
+
+// Statements run only when a label they contain is jumped to live as long as the label
+void Optimizer::eliminate_dead_code(shared_ptr<FuncDefNode> func) {
+    if(!func->body || has_label_addr(func->body))
+        return;
+    map<char*, char*, cstr_cmp> forwards;
+    find_jump_forwards(func->body, forwards);
+    thread_jumps(func->body, forwards);
+
+    DceContext ctx;
+    size_t count;
+    do {
+        count = ctx.live.size();
+        mark_reachable(func->body, true, ctx.live);
+    } while(ctx.live.size() != count);
+    find_read_vars(func->body, ctx.read_vars);
+    find_addr_taken(func->body, ctx.addr_taken);
+    func->reaches_end = remove_dead_code(func->body, true, ctx);
+
+    set<Node*> refs;
+    find_local_refs(func->body, refs);
+    func->local_vars.erase(remove_if(func->local_vars.begin(), func->local_vars.end(), 
+        [&](NodePtr var) { return !refs.count(var.get()); }), func->local_vars.end());
+}
+
+// ------------------------------ common subexpressions ------------------------------
+
+struct CseContext {
+    shared_ptr<FuncDefNode> func;
+    set<Node*> addr_taken;
+};
+
+// Whether evaluating node again gives the same value as long as nothing it reads is written
+static bool is_reusable(NodePtr node) {
+    if(node->type && has_qualifier(node->type, KW_VOLATILE))
+        return false;
+    switch(node->kind) {
+    case NK_LITERAL: case NK_GLOBAL_VAR: case NK_FUNC_DESG:
+        return true;
+    case NK_LOCAL_VAR:
+        return dynamic_pointer_cast<LocalVarNode>(node)->init_list.empty();
+    case NK_STRUCT_MEMBER:
+        return is_reusable(dynamic_pointer_cast<StructMemberNode>(node)->struc);
+    case NK_CONV: case NK_CAST: case NK_DEREF: case NK_ADDR: case '~': case '!': case '-':
+    case '+': case '*': case '/': case '%': case '&': case '|': case '^':
+    case '<': case P_LE: case P_EQ: case P_NE: case NK_SAL: case NK_SAR: case NK_SHR:
+        break;
+    default:
+        return false;
+    }
+    if(shared_ptr<UnaryOperNode> unary = dynamic_pointer_cast<UnaryOperNode>(node))
+        return is_reusable(unary->operand);
+    shared_ptr<BinaryOperNode> binary = dynamic_pointer_cast<BinaryOperNode>(node);
+    return binary && is_reusable(binary->left) && is_reusable(binary->right);
+}
+
+// Rough number of instructions saved by reusing the value: loads count twice, 
+// multiplications and divisions three times
+static int cse_cost(NodePtr node) {
+    int cost = 0;
+    switch(node->kind) {
+    case NK_LITERAL: case NK_GLOBAL_VAR: case NK_FUNC_DESG: case NK_LOCAL_VAR:
+        return 0;
+    case NK_ADDR:
+        return max(cse_cost(dynamic_pointer_cast<UnaryOperNode>(node)->operand) - 1, 0);
+    case NK_DEREF:
+        cost = 2;
+        break;
+    case '*': case '/': case '%':
+        cost = 3;
+        break;
+    default:
+        cost = dynamic_pointer_cast<BinaryOperNode>(node) ? 1 : 0;
+    }
+    for_each_child(node, [&](NodePtr& child) { cost += cse_cost(child); });
+    return cost;
+}
+
+static bool is_cse_candidate(NodePtr node) {
+    return node->type && is_scalar_value(node->type) && is_reusable(node) && cse_cost(node) >= 2;
+}
+
+static bool is_side_effect(NodePtr node) {
+    switch(node->kind) {
+    case NK_FUNC_CALL: case NK_FUNCPTR_CALL: case NK_DECL: case NK_VECTOR_LOOP:
+    case NK_PRE_INC: case NK_PRE_DEC: case NK_POST_INC: case NK_POST_DEC:
+        return true;
+    case '=':
+        return dynamic_pointer_cast<BinaryOperNode>(node) != nullptr;
+    case NK_LOCAL_VAR:
+        return !dynamic_pointer_cast<LocalVarNode>(node)->init_list.empty();
+    default:
+        return false;
+    }
+}
+
+// The lvalues written by node, with null for a call which may write any memory
+static void find_writes(NodePtr node, vector<NodePtr>& writes) {
+    switch(node->kind) {
+    case NK_FUNC_CALL: case NK_FUNCPTR_CALL: case NK_VECTOR_LOOP:
+        writes.push_back(nullptr);
+        break;
+    case '=':
+        if(shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node))
+            writes.push_back(expr->left);
+        break;
+    case NK_PRE_INC: case NK_PRE_DEC: case NK_POST_INC: case NK_POST_DEC:
+        writes.push_back(dynamic_pointer_cast<UnaryOperNode>(node)->operand);
+        break;
+    case NK_DECL:
+        writes.push_back(dynamic_pointer_cast<DeclNode>(node)->var);
+        break;
+    case NK_LOCAL_VAR:
+        if(!dynamic_pointer_cast<LocalVarNode>(node)->init_list.empty())
+            writes.push_back(node);
+        break;
+    }
+    for_each_child(node, [&](NodePtr& child) { find_writes(child, writes); });
+}
+
+static int count_side_effects(NodePtr node) {
+    int count = is_side_effect(node);
+    for_each_child(node, [&](NodePtr& child) { count += count_side_effects(child); });
+    return count;
+}
+
+// The variable a memory access lies in, or the pointer variable it is made through
+struct Access {
+    NodePtr var;
+    bool via_pointer = false;
+};
+
+static Access get_access(NodePtr node) {
+    Access access;
+    while(node->kind == NK_STRUCT_MEMBER)
+        node = dynamic_pointer_cast<StructMemberNode>(node)->struc;
+    if(node->kind == NK_LOCAL_VAR || node->kind == NK_GLOBAL_VAR) {
+        access.var = node;
+        return access;
+    }
+    if(node->kind != NK_DEREF)
+        return access;
+    NodePtr addr = dynamic_pointer_cast<UnaryOperNode>(node)->operand;
+    for(;;) {
+        if(addr->kind == NK_CONV || addr->kind == NK_CAST)
+            addr = dynamic_pointer_cast<UnaryOperNode>(addr)->operand;
+        else if((addr->kind == '+' || addr->kind == '-') && addr->type->kind == TK_PTR
+            && dynamic_pointer_cast<BinaryOperNode>(addr))
+            addr = dynamic_pointer_cast<BinaryOperNode>(addr)->left;
+        else
+            break;
+    }
+    if(addr->kind == NK_ADDR)
+        return get_access(dynamic_pointer_cast<UnaryOperNode>(addr)->operand);
+    // an array member decayed to a pointer
+    if(addr->kind == NK_STRUCT_MEMBER && addr->type->kind == TK_ARRAY)
+        return get_access(addr);
+    if((addr->kind == NK_LOCAL_VAR || addr->kind == NK_GLOBAL_VAR) && 
+        (addr->type->kind == TK_ARRAY || addr->type->kind == TK_PTR)) {
+        access.var = addr;
+        access.via_pointer = addr->type->kind == TK_PTR;
+    }
+    return access;
+}
+
+static bool same_var(NodePtr a, NodePtr b) {
+    if(a->kind == NK_GLOBAL_VAR && b->kind == NK_GLOBAL_VAR)
+        return !strcmp(dynamic_pointer_cast<GlobalVarNode>(a)->global_label, 
+            dynamic_pointer_cast<GlobalVarNode>(b)->global_label);
+    return a == b;
+}
+
+static bool is_const_object(NodePtr var) {
+    Type* type = var->type;
+    while(type->kind == TK_ARRAY)
+        type = dynamic_cast<ArrayType*>(type)->elem_type;
+    return has_qualifier(type, KW_CONST);
+}
+
+// Objects are told apart by name; a restrict pointer is the only way to the 
+// object it points to, so it aliases neither named objects nor other restrict pointers
+static bool may_alias(Access x, Access y) {
+    if(!x.var || !y.var)
+        return true;
+    if(x.via_pointer && y.via_pointer)
+        return same_var(x.var, y.var) || !is_restrict(x.var) || !is_restrict(y.var);
+    if(x.via_pointer || y.via_pointer)
+        return !is_restrict(x.via_pointer ? x.var : y.var);
+    return same_var(x.var, y.var);
+}
+
+// Locals whose address is never taken can only be written by name
+static bool is_register_var(NodePtr var, CseContext& ctx) {
+    return var->kind == NK_LOCAL_VAR && var->type->kind != TK_ARRAY && !ctx.addr_taken.count(var.get());
+}
+
+static bool has_node(NodePtr node, Node* target) {
+    if(node.get() == target)
+        return true;
+    bool found = false;
+    for_each_child(node, [&](NodePtr& child) { found = found || has_node(child, target); });
+    return found;
+}
+
+// Whether a load in expr may read memory written through store, or by a call if store is null
+static bool has_aliased_load(NodePtr expr, Access* store, CseContext& ctx) {
+    Access load;
+    if(expr->kind == NK_DEREF)
+        load = get_access(expr);
+    else if((expr->kind == NK_LOCAL_VAR || expr->kind == NK_GLOBAL_VAR) && expr->type->kind != TK_ARRAY)
+        load.var = expr;
+    if(expr->kind == NK_DEREF || load.var) {
+        bool constant = load.var && !load.via_pointer && is_const_object(load.var);
+        bool in_memory = !load.var || load.via_pointer || !is_register_var(load.var, ctx);
+        if(in_memory && !constant && (!store || may_alias(*store, load)))
+            return true;
+    }
+    bool found = false;
+    for_each_child(expr, [&](NodePtr& child) { found = found || has_aliased_load(child, store, ctx); });
+    return found;
+}
+
+// Whether the value of expr may change by writing the lvalue target, 
+// or by a call if target is null
+static bool is_killed(NodePtr expr, NodePtr target, CseContext& ctx) {
+    if(!target)
+        return has_aliased_load(expr, nullptr, ctx);
+    Access store = get_access(target);
+    if(store.var && !store.via_pointer && is_register_var(store.var, ctx))
+        return has_node(expr, store.var.get());
+    return has_aliased_load(expr, &store, ctx);
+}
+
+// An occurrence of an expression evaluated unconditionally and before 
+// every side effect of its statement
+struct CseSlot {
+    NodePtr* slot;
+    size_t stmt;
+};
+
+static void find_cse_slots(NodePtr& node, size_t stmt, int effects, vector<CseSlot>& slots);
+
+// The object an lvalue designates is not loaded, only its address computed
+static void find_lvalue_slots(NodePtr& node, size_t stmt, int effects, vector<CseSlot>& slots) {
+    if(node->kind == NK_STRUCT_MEMBER)
+        find_lvalue_slots(dynamic_pointer_cast<StructMemberNode>(node)->struc, stmt, effects, slots);
+    else if(node->kind == NK_DEREF)
+        find_cse_slots(dynamic_pointer_cast<UnaryOperNode>(node)->operand, stmt, effects, slots);
+}
+
+static void find_cse_slots(NodePtr& node, size_t stmt, int effects, vector<CseSlot>& slots) {
+    effects -= is_side_effect(node);
+    if(effects == 0 && is_cse_candidate(node)) {
+        for(auto& slot:slots) {
+            if(slot.slot == &node)
+                return;
+        }
+        slots.push_back({&node, stmt});
+    }
+    switch(node->kind) {
+    case NK_COMPOUND_STMT:
+        return;
+    case NK_LOCAL_VAR:
+        return;
+    case NK_TERNARY:
+        find_cse_slots(dynamic_pointer_cast<TernaryOperNode>(node)->cond, stmt, effects, slots);
+        return;
+    case P_LOGAND: case P_LOGOR:
+        find_cse_slots(dynamic_pointer_cast<BinaryOperNode>(node)->left, stmt, effects, slots);
+        return;
+    case '=':
+        if(shared_ptr<BinaryOperNode> expr = dynamic_pointer_cast<BinaryOperNode>(node)) {
+            find_lvalue_slots(expr->left, stmt, effects, slots);
+            find_cse_slots(expr->right, stmt, effects, slots);
+            return;
+        }
+        break;
+    case NK_ADDR: case NK_PRE_INC: case NK_PRE_DEC: case NK_POST_INC: case NK_POST_DEC:
+        find_lvalue_slots(dynamic_pointer_cast<UnaryOperNode>(node)->operand, stmt, effects, slots);
+        return;
+    }
+    for_each_child(node, [&](NodePtr& child) { find_cse_slots(child, stmt, effects, slots); });
+}
+
+// A statement of a straight-line run: the expression it evaluates
+// and the list it is in, where computations are hoisted to
+struct RunStmt {
+    vector<NodePtr>* list;
+    size_t index;
+};
+
+static NodePtr& run_expr(RunStmt stmt) {
+    NodePtr& node = (*stmt.list)[stmt.index];
+    if(node->kind == NK_IF)
+        return dynamic_pointer_cast<IfNode>(node)->cond;
+    if(node->kind == NK_RETURN)
+        return dynamic_pointer_cast<ReturnNode>(node)->return_val;
+    return node;
+}
+
+// if(cond) goto label, or if(!cond) goto label
+static bool is_cond_jump(shared_ptr<IfNode> stmt) {
+    return (!stmt->then && stmt->els && stmt->els->kind == NK_JUMP) 
+        || (!stmt->els && stmt->then && stmt->then->kind == NK_JUMP);
+}
+
+// Statements which continue a run, and those ending it while still evaluating an expression first
+enum RunKind {RUN_NONE, RUN_MEMBER, RUN_LAST};
+
+static RunKind run_kind(NodePtr node) {
+    switch(node->kind) {
+    case NK_DECL:
+        return has_control(node) ? RUN_NONE : RUN_MEMBER;
+    case NK_IF: {
+        shared_ptr<IfNode> stmt = dynamic_pointer_cast<IfNode>(node);
+        if(has_control(stmt->cond))
+            return RUN_NONE;
+        return is_cond_jump(stmt) ? RUN_MEMBER : RUN_LAST;
+    }
+    case NK_RETURN: {
+        NodePtr value = dynamic_pointer_cast<ReturnNode>(node)->return_val;
+        return value && !has_control(value) ? RUN_LAST : RUN_NONE;
+    }
+    default:
+        return is_stmt(node) || has_control(node) ? RUN_NONE : RUN_MEMBER;
+    }
+}
+
+// Reuse the value of the costliest expression computed more than once in the run, 
+// through a temporary assigned before its first occurrence
+static bool eliminate_in_run(vector<RunStmt>& run, CseContext& ctx) {
+    vector<CseSlot> slots;
+    vector<vector<NodePtr>> writes(run.size());
+    for(size_t i = 0; i < run.size(); ++i) {
+        NodePtr& expr = run_expr(run[i]);
+        if(!expr)
+            continue;
+        find_cse_slots(expr, i, count_side_effects(expr), slots);
+        find_writes(expr, writes[i]);
+    }
+    vector<int> costs;
+    for(auto& slot:slots)
+        costs.push_back(cse_cost(*slot.slot));
+    vector<size_t> order;
+    for(size_t i = 0; i < slots.size(); ++i)
+        order.push_back(i);
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+    for(size_t first:order) {
+        NodePtr expr = *slots[first].slot;
+        vector<CseSlot> uses = {slots[first]};
+        size_t last = slots[first].stmt;
+        for(size_t i = first + 1; i < slots.size(); ++i) {
+            if(!same_expr(*slots[i].slot, expr))
+                continue;
+            bool killed = false;
+            for(size_t j = last; j < slots[i].stmt && !killed; ++j) {
+                for(auto& target:writes[j])
+                    killed = killed || is_killed(expr, target, ctx);
+            }
+            if(killed)
+                break;
+            uses.push_back(slots[i]);
+            last = slots[i].stmt;
+        }
+        if(uses.size() < 2)
+            continue;
+        TokenPtr tok = expr->first_token;
+        shared_ptr<LocalVarNode> var = arena_make<LocalVarNode>(tok, expr->type, make_tmpname());
+        ctx.func->local_vars.push_back(var);
+        for(auto& use:uses)
+            *use.slot = var;
+        RunStmt at = run[slots[first].stmt];
+        at.list->insert(at.list->begin() + at.index, make_binary_oper_node(tok, '=', expr->type, var, expr));
+        return true;
+    }
+    return false;
+}
+
+// The runs starting at list[index]. A run goes on into the arms of an if statement 
+// ending it, which are entered from nowhere else.
+static void find_runs(vector<NodePtr>& list, size_t index, vector<RunStmt>& run, 
+    vector<vector<RunStmt>>& runs, int depth) {
+    for(; index < list.size(); ++index) {
+        RunKind kind = run_kind(list[index]);
+        if(kind == RUN_NONE)
+            break;
+        run.push_back({&list, index});
+        if(kind == RUN_MEMBER)
+            continue;
+        shared_ptr<IfNode> stmt = dynamic_pointer_cast<IfNode>(list[index]);
+        if(!stmt || depth == 0)
+            break;
+        size_t size = run.size();
+        for(NodePtr* arm:{&stmt->then, &stmt->els}) {
+            if(!*arm || (*arm)->kind == NK_JUMP)
+                continue;
+            if((*arm)->kind != NK_COMPOUND_STMT)
+                *arm = make_compound_stmt_node((*arm)->first_token, vector<NodePtr>{*arm});
+            find_runs(dynamic_pointer_cast<CompoundStmtNode>(*arm)->list, 0, run, runs, depth - 1);
+            run.resize(size);
+        }
+        return;
+    }
+    if(!run.empty())
+        runs.push_back(run);
+}
+
+static void eliminate_in_block(NodePtr node, CseContext& ctx) {
+    if(node->kind == NK_COMPOUND_STMT) {
+        vector<NodePtr>& list = dynamic_pointer_cast<CompoundStmtNode>(node)->list;
+        for(size_t i = 0; i < list.size(); ++i) {
+            if(i > 0 && run_kind(list[i - 1]) == RUN_MEMBER)
+                continue;
+            // every change inserts a statement and the runs are looked for again
+            for(bool changed = true; changed; ) {
+                vector<RunStmt> run;
+                vector<vector<RunStmt>> runs;
+                find_runs(list, i, run, runs, 4);
+                changed = false;
+                for(auto& path:runs) {
+                    if(eliminate_in_run(path, ctx)) {
+                        changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    for_each_child(node, [&](NodePtr& child) { eliminate_in_block(child, ctx); });
+}
+
+// Values computed more than once in straight-line code are computed once into a temporary.
+// Loads are reused until a store that may alias them, or a call.
+void Optimizer::eliminate_common_subexprs(shared_ptr<FuncDefNode> func) {
+    if(!func->body)
+        return;
+    CseContext ctx;
+    ctx.func = func;
+    find_addr_taken(func->body, ctx.addr_taken);
+    eliminate_in_block(func->body, ctx);
+}
+
+void Optimizer::run() {
+    if(!optimize) {
+        for(auto node:ast) {
+            if(node->kind == NK_FUNC_DEF)
+                assign_stack_slots(dynamic_pointer_cast<FuncDefNode>(node));
+        }
+        return;
+    }
+    for(auto& node:ast) {
+        if(node->kind == NK_FUNC_DEF) {
+            node = fold(node);
+        }
+    }
+    inline_functions();
+    for(auto& node:ast) {
+        if(node->kind == NK_FUNC_DEF) {
+            node = fold(node);
+        }
+    }
+    for(auto node:ast) {
+        if(node->kind == NK_FUNC_DEF) {
+            optimize_loops(dynamic_pointer_cast<FuncDefNode>(node));
+            eliminate_dead_code(dynamic_pointer_cast<FuncDefNode>(node));
+            eliminate_common_subexprs(dynamic_pointer_cast<FuncDefNode>(node));
+        }
+    }
+    remove_unused_symbols();
+    for(auto node:ast) {
+        if(node->kind == NK_FUNC_DEF) {
+            assign_stack_slots(dynamic_pointer_cast<FuncDefNode>(node));
+            mark_tail_calls(dynamic_pointer_cast<FuncDefNode>(node));
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <functional>
+#include "ast.h"
+
+class Node;
+
+using NodePtr = std::shared_ptr<Node>;
+
+// Apply f to each direct child of node
+void for_each_child(NodePtr node, const std::function<void(NodePtr&)>& f);
+
+// Machine independent optimizations on the AST,
+// run after parsing and before code generation.
+class Optimizer {
+public:
+    Optimizer(std::vector<NodePtr>& ast): ast(ast) {}
+
+    void run();
+
+    // constant folding
+    NodePtr fold(NodePtr node);
+    NodePtr fold_lvalue(NodePtr node);
+    NodePtr fold_unary(std::shared_ptr<UnaryOperNode> node);
+    NodePtr fold_binary(std::shared_ptr<BinaryOperNode> node);
+    NodePtr fold_ternary(std::shared_ptr<TernaryOperNode> node);
+    NodePtr fold_if(std::shared_ptr<IfNode> node);
+    void fold_init_list(std::vector<NodePtr>& init_list);
+    void fold_decl(std::shared_ptr<DeclNode> decl);
+
+    // function inlining
+    void inline_functions();
+    void inline_calls(NodePtr& node, std::shared_ptr<FuncDefNode> caller);
+    bool should_inline(std::shared_ptr<FuncDefNode> callee, 
+        std::shared_ptr<FuncCallNode> call, std::shared_ptr<FuncDefNode> caller);
+    NodePtr inline_call(std::shared_ptr<FuncDefNode> callee, 
+        std::shared_ptr<FuncCallNode> call, std::shared_ptr<FuncDefNode> caller);
+
+    // vectorization, loop-invariant code motion and induction variable strength reduction
+    void optimize_loops(std::shared_ptr<FuncDefNode> func);
+
+    // dead code elimination
+    void eliminate_dead_code(std::shared_ptr<FuncDefNode> func);
+    void remove_unused_symbols();
+
+    // common subexpression and redundant load elimination
+    void eliminate_common_subexprs(std::shared_ptr<FuncDefNode> func);
+
+    // stack slot assignment
+    void assign_stack_slots(std::shared_ptr<FuncDefNode> func);
+
+    // tail calls
+    void mark_tail_calls(std::shared_ptr<FuncDefNode> func);
+
+    // with -O0 only the stack slots are assigned, one per variable
+    bool optimize = true;
+
+private:
+    std::vector<NodePtr>& ast;
+
+    std::map<char*, std::shared_ptr<FuncDefNode>, cstr_cmp> funcs;
+    // number of direct calls and whether the address is taken, by function name
+    std::map<char*, int, cstr_cmp> call_count;
+    std::set<char*, cstr_cmp> address_taken;
+    // nodes reachable from more than one parent must not get private labels
+    std::set<Node*> shared_nodes;
+    // calls returned by the caller
+    std::set<Node*> tail_sites;
+    int caller_cost = 0;
+
+    // const-qualified locals initialized with a literal
+    std::map<Node*, NodePtr> const_vars;
+};
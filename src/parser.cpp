@@ -39,17 +39,6 @@ static inline NodePtr make_deref_node(TokenPtr tok, NodePtr p) {
         dynamic_cast<PtrType*>(p->type)->ptr_type, p);
 }
 
-static Type* get_struct_field_type(std::vector<std::pair<char*, Type*>>& fields, 
-    char* name, int* index) {
-    for(size_t i = 0; i < fields.size(); ++i) {
-        if(!strcmp(fields[i].first, name)) {
-            if(index) *index = i;
-            return fields[i].second;
-        }
-    }
-    return nullptr;
-}
-
 bool is_lvalue(NodePtr node) {
     switch (node->kind) {
     case NK_LOCAL_VAR: case NK_GLOBAL_VAR: case NK_DEREF: case NK_STRUCT_MEMBER:
@@ -102,7 +91,7 @@ static void untie_unnamed_struct(vector<pair<char*, Type*>>& fields,
     Type* unnamed_struct, int offset) {
     
     assert(unnamed_struct->kind == TK_STRUCT || unnamed_struct->kind == TK_UNION);
-    auto fs = dynamic_cast<StructType*>(unnamed_struct)->fields;
+    auto& fs = dynamic_cast<StructType*>(unnamed_struct)->fields;
     for(auto& f:fs) {
         Type* type = f.second;
         type->offset += offset;
@@ -466,29 +455,26 @@ NodePtr Parser::read_constant(TokenPtr t) {
     else {
         char* end;
         // support binary integer
-        long long value = !strncasecmp(num, "ob", 2) ? strtoul(num, &end, 2) 
+        unsigned long long value = !strncasecmp(num, "0b", 2) ? strtoul(num + 2, &end, 2) 
             : strtoul(num, &end, 0);
-        Type* type = (!strcasecmp(num, "u") ? type_uint : 
-                     (!strcasecmp(num, "l") ? type_long : 
-                     (!strcasecmp(num, "ll") ? type_llong : 
-                     ((!strcasecmp(num, "ul") || !strcasecmp(num, "lu")) ? type_ulong : 
-                     ((!strcasecmp(num, "ull") || !strcasecmp(num, "llu")) ? type_ullong :
-                     nullptr)))));
-        if(type != nullptr)
-            return make_int_node(tok, type, value);
-
-        // C11 6.4.4.1p5: Decimal constant type is int, long, or long long
+        bool is_unsigned = strchr(end, 'u') || strchr(end, 'U');
+        int longs = 0;
+        for(char* p = end; *p; ++p)
+            longs += (*p == 'l' || *p == 'L');
+        bool is_decimal = (num[0] != '0');
+
+        // C11 6.4.4.1p5: The type is the first of the list for the suffix in which 
+        // the value can be represented, octal or hexadecimal constant type may be unsigned.
         // in here, long = long long
-        if(num[0] != '0') {
-            type = (value <= INT_MAX) ? type_int : type_long;
-        }
-        // Octal or hexadecimal constant type may be unsigned
-        else {
-            type = (value <= INT_MAX) ? type_int : 
-                   (value <= UINT_MAX) ? type_uint :
-                   (value <= LONG_MAX) ? type_long :
-                   type_ulong;
-        }
+        Type* type;
+        if(!is_unsigned && !longs && value <= INT_MAX)
+            type = type_int;
+        else if(!longs && (is_unsigned || !is_decimal) && value <= UINT_MAX)
+            type = type_uint;
+        else if(!is_unsigned && value <= LONG_MAX)
+            type = (longs == 2) ? type_llong : type_long;
+        else
+            type = (longs == 2) ? type_ullong : type_ulong;
         return make_int_node(tok, type, value);
     }
 }
@@ -738,7 +724,7 @@ NodePtr Parser::read_struct_member(NodePtr node) {
         return error_node;
     }
     StructType* struc = dynamic_cast<StructType*>(type);
-    Type* field = get_struct_field_type(struc->fields, name_str, nullptr);
+    Type* field = struc->get_field(name_str);
     if(!field) {
         errort(name, "‘%s’ has no member named ‘%s’", type->to_string(), name_str);
         return error_node;
@@ -857,9 +843,7 @@ NodePtr Parser::read_unary_expr() {
 sizeof_operand : unary_expr | '(' type_name ')'
 */
 Type* Parser::read_sizeof_operand() {
-    TokenPtr tok = pp->get_token();
-    if(tok->is_keyword('(') && is_type_name(pp->peek_token())) {
-        pp->unget_token(tok);
+    if(pp->peek_token()->is_keyword('(') && is_type_name(pp->peek_token(1))) {
         NodePtr node = read_post_expr(true);
         // '(' type_name ')'
         if(node->kind == NK_TYPEDEF) {
@@ -869,7 +853,6 @@ Type* Parser::read_sizeof_operand() {
         return node->type;
     }
     // other unary_expr
-    pp->unget_token(tok);
     NodePtr node = read_unary_expr();
     return node->type;
 }
@@ -878,9 +861,8 @@ Type* Parser::read_sizeof_operand() {
 cast_expr :	unary_expr | '(' type_name ')' cast_expr
 */
 NodePtr Parser::read_cast_expr() {
-    TokenPtr tok = pp->get_token();
-    if(tok->is_keyword('(') && is_type_name(pp->peek_token())) {
-        pp->unget_token(tok);
+    TokenPtr tok = pp->peek_token();
+    if(tok->is_keyword('(') && is_type_name(pp->peek_token(1))) {
         NodePtr node = read_post_expr(true);
         // '(' type_name ')' cast_expr
         if(node->kind == NK_TYPEDEF) {
@@ -891,240 +873,87 @@ NodePtr Parser::read_cast_expr() {
         return node;
     }
     // other unary_expr
-    pp->unget_token(tok);
     return read_unary_expr();
 }
 
 /*
-mul_expr :	cast_expr mul_expr_tail 
-mul_expr_tail :	'*' cast_expr mul_expr_tail
-				|	'/' cast_expr mul_expr_tail
-				|	'%' cast_expr mul_expr_tail
-				|	'empty'
-*/
-NodePtr Parser::read_mul_expr() {
-    NodePtr node = read_cast_expr();
-    return read_mul_expr_tail(node);
-}
-NodePtr Parser::read_mul_expr_tail(NodePtr node) {
-    TokenPtr tok = pp->peek_token();
-    if(pp->next('*')) {
-        node = make_binop(tok, '*', convert(node), convert(read_cast_expr()));
-        return read_mul_expr_tail(node);
-    }
-    if(pp->next('/')) {
-        node = make_binop(tok, '/', convert(node), convert(read_cast_expr()));
-        return read_mul_expr_tail(node);
-    }
-    if(pp->next('%')) {
-        node = make_binop(tok, '%', convert(node), convert(read_cast_expr()));
-        return read_mul_expr_tail(node);
-    }
-    return node;
-}
-
-/*
-add_expr :	mul_expr add_expr_tail 
-add_expr_tail :	'+' mul_expr add_expr_tail
-				|	'-' mul_expr add_expr_tail
-				|	'empty'
+mul_expr :	cast_expr | mul_expr ('*' | '/' | '%') cast_expr
+add_expr :	mul_expr | add_expr ('+' | '-') mul_expr
+shift_expr :	add_expr | shift_expr ('<<' | '>>') add_expr
+rela_expr :	shift_expr | rela_expr ('<' | '>' | '<=' | '>=') shift_expr
+equal_expr :	rela_expr | equal_expr ('==' | '!=') rela_expr
+and_expr :	equal_expr | and_expr '&' equal_expr
+xor_expr :	and_expr | xor_expr '^' and_expr
+or_expr :	xor_expr | or_expr '|' xor_expr
+land_expr :	or_expr | land_expr '&&' or_expr
+lor_expr :	land_expr | lor_expr '||' land_expr
+
+All of these are left-associative, so they are read by precedence climbing 
+over the table below instead of one function per level.
 */
-NodePtr Parser::read_add_expr(){
-    NodePtr node = read_mul_expr();
-    return read_add_expr_tail(node);
-}
-NodePtr Parser::read_add_expr_tail(NodePtr node) {
-    TokenPtr tok = pp->peek_token();
-    if(pp->next('+')) {
-        node = make_binop(tok, '+', convert(node), convert(read_mul_expr()));
-        return read_add_expr_tail(node);
-    }
-    if(pp->next('-')) {
-        node = make_binop(tok, '-', convert(node), convert(read_mul_expr()));
-        return read_add_expr_tail(node);
+static int get_binop_prec(int kind) {
+    switch(kind) {
+    case '*': case '/': case '%': return 10;
+    case '+': case '-': return 9;
+    case P_SAL: case P_SAR: return 8;
+    case '<': case '>': case P_LE: case P_GE: return 7;
+    case P_EQ: case P_NE: return 6;
+    case '&': return 5;
+    case '^': return 4;
+    case '|': return 3;
+    case P_LOGAND: return 2;
+    case P_LOGOR: return 1;
     }
-    return node;
+    return 0;
 }
 
-/*
-shift_expr :	add_expr shift_expr_tail 
-shift_expr_tail :	'<<' add_expr shift_expr_tail
-				|	'>>' add_expr shift_expr_tail
-				|	'empty'
-*/
-NodePtr Parser::read_shift_expr() {
-    NodePtr node = read_add_expr();
-    return read_shift_expr_tail(node);
+// read a binary expression whose operators bind at least as tight as min_prec
+NodePtr Parser::read_binary_expr(int min_prec) {
+    NodePtr node = read_cast_expr();
+    return read_binary_expr_tail(node, min_prec);
 }
-NodePtr Parser::read_shift_expr_tail(NodePtr node) {
-    TokenPtr tok = pp->get_token();
-    if(tok->is_keyword(P_SAL) || tok->is_keyword(P_SAR)) {
-        int op = tok->kind;
-        op = (op == P_SAL ? NK_SAL : (node->type->is_unsigned ? NK_SHR : NK_SAR));
-        NodePtr right = read_add_expr();
-        if(!node->type->is_int_type() || !right->type->is_int_type()) {
-            errort(tok, "invalid operands to binary << (have ‘%s’ and ‘%s’)", 
-                node->type->to_string(), right->type->to_string());
-            return error_node;
+NodePtr Parser::read_binary_expr_tail(NodePtr node, int min_prec) {
+    while(true) {
+        TokenPtr tok = pp->get_token();
+        int prec = get_binop_prec(tok->kind);
+        if(prec == 0 || prec < min_prec) {
+            pp->unget_token(tok);
+            return node;
+        }
+        NodePtr right = read_binary_expr(prec + 1);
+        switch(tok->kind) {
+        case P_SAL: case P_SAR: {
+            int op = (tok->kind == P_SAL ? NK_SAL : (node->type->is_unsigned ? NK_SHR : NK_SAR));
+            if(!node->type->is_int_type() || !right->type->is_int_type()) {
+                errort(tok, "invalid operands to binary << (have ‘%s’ and ‘%s’)", 
+                    node->type->to_string(), right->type->to_string());
+                return error_node;
+            }
+            node = make_binop(tok, op, convert(node), convert(right));
+            break;
         }
-        node = make_binop(tok, op, convert(node), convert(right));
-        return read_shift_expr_tail(node);
-    }
-    pp->unget_token(tok);
-    return node;
-}
-
-/*
-rela_expr :	shift_expr rela_expr_tail 
-rela_expr_tail :	'<' shift_expr rela_expr_tail
-				|	'>' shift_expr rela_expr_tail
-				|	'<=' shift_expr rela_expr_tail
-				|	'>=' shift_expr rela_expr_tail
-				|	'empty'
-*/
-NodePtr Parser::read_relational_expr() {
-    NodePtr node = read_shift_expr();
-    return read_relational_expr_tail(node);
-}
-NodePtr Parser::read_relational_expr_tail(NodePtr node) {
-    bool is_relational_expr = false;
-    TokenPtr tok = pp->peek_token();
-    if(pp->next('<')) {
-        is_relational_expr = true;
-        node = make_binop(tok, '<', convert(node), convert(read_shift_expr()));
-    }
-    if(pp->next('>')) {
-        is_relational_expr = true;
-        node = make_binop(tok, '<', convert(read_shift_expr()), convert(node));
-    }
-    if(pp->next(P_LE)) {
-        is_relational_expr = true;
-        node = make_binop(tok, P_LE, convert(node), convert(read_shift_expr()));
-    }
-    if(pp->next(P_GE)) {
-        is_relational_expr = true;
-        node = make_binop(tok, P_LE, convert(read_shift_expr()), convert(node));
-    }
-    if(is_relational_expr) {
         // C11 6.5.8p6: relational operators shall yield 1 if the specified 
         // relation is true and 0 if it is false. The result has type int.
-        node->type = type_int;
-        return read_relational_expr_tail(node);
-    }
-    return node;
-}
-
-/*
-equal_expr :	rela_expr equal_expr_tail 
-equal_expr_tail :	'==' rela_expr equal_expr_tail
-					|	'!=' rela_expr equal_expr_tail
-					|	'empty'
-*/
-NodePtr Parser::read_equal_expr() {
-    NodePtr node = read_relational_expr();
-    return read_equal_expr_tail(node);
-}
-NodePtr Parser::read_equal_expr_tail(NodePtr node) {
-    TokenPtr tok = pp->get_token();
-    if(tok->is_keyword(P_EQ) || tok->is_keyword(P_NE)) {
-        int op = tok->kind;
-        NodePtr right = read_relational_expr();
-        node = make_binop(tok, op, convert(node), convert(right));
-        node->type = type_int; // bool convert to int
-        return read_equal_expr_tail(node);
-    }
-    pp->unget_token(tok);
-    return node;
-}
-
-/*
-and_expr :	equal_expr and_expr_tail 
-and_expr_tail :	'&' equal_expr and_expr_tail
-				|	'empty'
-*/
-NodePtr Parser::read_and_expr() {
-    NodePtr node = read_equal_expr();
-    return read_and_expr_tail(node);
-}
-NodePtr Parser::read_and_expr_tail(NodePtr node) {
-    TokenPtr tok = pp->peek_token();
-    if(pp->next('&')) {
-        node = make_binop(tok, '&', convert(node), convert(read_equal_expr()));
-        return read_and_expr_tail(node);
-    }
-    return node;
-}   
-
-/*
-xor_expr :	and_expr xor_expr_tail 
-xor_expr_tail :	'^' and_expr xor_expr_tail
-				|	'empty'
-*/
-NodePtr Parser::read_xor_expr() {
-    NodePtr node = read_and_expr();
-    return read_xor_expr_tail(node);
-}
-NodePtr Parser::read_xor_expr_tail(NodePtr node) {
-    TokenPtr tok = pp->peek_token();
-    if(pp->next('^')) {
-        node = make_binop(tok, '^', convert(node), convert(read_and_expr()));
-        return read_xor_expr_tail(node);
-    }
-    return node;
-}
-
-/*
-or_expr :	xor_expr or_expr_tail 
-or_expr_tail :	'|' xor_expr or_expr_tail
-				|	'empty'
-*/
-NodePtr Parser::read_or_expr() {
-    NodePtr node = read_xor_expr();
-    return read_or_expr_tail(node);
-}
-NodePtr Parser::read_or_expr_tail(NodePtr node) {
-    TokenPtr tok = pp->peek_token();
-    if(pp->next('|')) {
-        node = make_binop(tok, '|', convert(node), convert(read_xor_expr()));
-        return read_or_expr_tail(node);
-    }
-    return node;
-}
-
-/*
-land_expr :	or_expr land_expr_tail 
-land_expr_tail :	'&&' or_expr land_expr_tail
-				|	'empty'
-*/
-NodePtr Parser::read_land_expr() {
-    NodePtr node = read_or_expr();
-    return read_land_expr_tail(node);
-}
-NodePtr Parser::read_land_expr_tail(NodePtr node) {
-    TokenPtr tok = pp->peek_token();
-    if(pp->next(P_LOGAND)) {
-        node = make_binop(tok, P_LOGAND, convert(node), convert(read_or_expr()));
-        return read_land_expr_tail(node);
-    }
-    return node;
-}
-
-/*
-lor_expr :	land_expr lor_expr_tail 
-lor_expr_tail :	'||' land_expr lor_expr_tail
-				|	'empty'
-*/
-NodePtr Parser::read_lor_expr() {
-    NodePtr node = read_land_expr();
-    return read_lor_expr_tail(node);
-}
-NodePtr Parser::read_lor_expr_tail(NodePtr node) {
-    TokenPtr tok = pp->peek_token();
-    if(pp->next(P_LOGOR)) {
-        node = make_binop(tok, P_LOGOR, convert(node), convert(read_land_expr()));
-        return read_lor_expr_tail(node);
+        case '<': case P_LE:
+            node = make_binop(tok, tok->kind, convert(node), convert(right));
+            node->type = type_int;
+            break;
+        case '>':
+            node = make_binop(tok, '<', convert(right), convert(node));
+            node->type = type_int;
+            break;
+        case P_GE:
+            node = make_binop(tok, P_LE, convert(right), convert(node));
+            node->type = type_int;
+            break;
+        case P_EQ: case P_NE:
+            node = make_binop(tok, tok->kind, convert(node), convert(right));
+            node->type = type_int; // bool convert to int
+            break;
+        default:
+            node = make_binop(tok, tok->kind, convert(node), convert(right));
+        }
     }
-    return node;
 }
 
 /*
@@ -1132,7 +961,7 @@ cond_expr :	lor_expr cond_expr_tail
 cond_expr_tail :	'?' expr ':' cond_expr | 'empty'
 */
 NodePtr Parser::read_cond_expr() {
-    NodePtr cond = read_lor_expr();
+    NodePtr cond = read_binary_expr(1);
     return read_cond_expr_tail(cond);
 }
 NodePtr Parser::read_cond_expr_tail(NodePtr cond) {
@@ -1370,6 +1199,8 @@ Type* Parser::read_decl_spec() {
     vector<int> type_qualifier;
     bool is_inline = false;
     bool is_noreturn = false;
+    bool is_always_inline = false;
+    bool is_noinline = false;
     int sig = 0;
     int align = -1;
 
@@ -1418,6 +1249,7 @@ Type* Parser::read_decl_spec() {
         // function-specifier
         case KW_INLINE: is_inline = true; break;
         case KW_NORETURN: is_noreturn = true; break;
+        case KW_ATTRIBUTE: read_attribute(&is_always_inline, &is_noinline); break;
         // type-specifier
         case KW_VOID: type = type_void; break;
         case KW_BOOL: type = type_bool; break;
@@ -1559,13 +1391,15 @@ update_type:
     // update done
 complete_type:
     if((sclass && sclass != KW_TYPEDEF) || !type_qualifier.empty() 
-            || is_inline || is_noreturn || align != -1) {
+            || is_inline || is_noreturn || is_always_inline || is_noinline || align != -1) {
         type = type->copy();
     }
     type->storage_class = sclass;
     if(!type_qualifier.empty()) type->type_qualifier = type_qualifier;
     type->is_inline = is_inline;
     type->is_noreturn = is_noreturn;
+    type->is_always_inline = is_always_inline;
+    type->is_noinline = is_noinline;
     if(align != -1) type->align = align;
     return type;
 }
@@ -1628,6 +1462,7 @@ Type* Parser::read_struct_or_union_spec(int kind) {
         struct_type->fields = update_struct_offset(size, align, fields);
     else
         struct_type->fields = update_union_offset(size, align, fields);
+    struct_type->build_field_index();
     struct_type->size = size;
     struct_type->align = align;
     return struct_type;
@@ -1823,6 +1658,47 @@ Type* Parser::read_typeof() {
     return type;
 }
 
+/*
+attribute : '__attribute__' '(' '(' attr_list ')' ')'
+attr_list : attr attr_list_tail | 'empty'
+attr_list_tail : ',' attr attr_list_tail | 'empty'
+attr : 'ident' | 'ident' '(' tokens ')'
+
+Only always_inline and noinline are meaningful, other attributes are skipped.
+*/
+void Parser::read_attribute(bool* always_inline, bool* noinline) {
+    if(!pp->next('(') || !pp->next('(')) {
+        parser_error("expected '(('");
+        return;
+    }
+    while(!pp->next(')')) {
+        TokenPtr tok = pp->get_token();
+        if(tok->kind == TEOF) {
+            errort(tok, "unexpected end");
+            return;
+        }
+        if(tok->is_ident("always_inline") || tok->is_ident("__always_inline__"))
+            *always_inline = true;
+        else if(tok->is_ident("noinline") || tok->is_ident("__noinline__"))
+            *noinline = true;
+        if(pp->next('(')) {
+            for(int depth = 1; depth > 0;) {
+                tok = pp->get_token();
+                if(tok->kind == TEOF) {
+                    errort(tok, "unexpected end");
+                    return;
+                }
+                if(tok->kind == '(') depth++;
+                if(tok->kind == ')') depth--;
+            }
+        }
+        pp->next(',');
+    }
+    if(!pp->next(')')) {
+        parser_error("expected ')'");
+    }
+}
+
 /*
 declarator :	pointer direct_declarator | direct_declarator
 
@@ -1872,13 +1748,21 @@ Type* Parser::read_declarator(char** name, Type* basetype, vector<NodePtr>* para
         return r;
     }
     auto skip_type_qualifier = [&](){ 
-        while(pp->next(KW_CONST) || pp->next(KW_RESTRICT) || pp->next(KW_VOLATILE)
-            || pp->next(KW_ATOMIC)); 
+        bool is_restrict = false;
+        while(pp->next(KW_CONST) || pp->next(KW_VOLATILE) || pp->next(KW_ATOMIC)
+            || (pp->next(KW_RESTRICT) && (is_restrict = true)));
+        return is_restrict;
     };
     if(pp->next('*')) {
-        skip_type_qualifier(); // Temporarily ignore type qualifier
-        Type* r = read_declarator(name, make_ptr_type(basetype), params, declarator_kind);
+        Type* ptr_type = make_ptr_type(basetype);
+        // Temporarily ignore type qualifier, except restrict which allows vectorization
+        bool is_restrict = skip_type_qualifier();
+        if(is_restrict)
+            ptr_type = ptr_type->copy();
+        Type* r = read_declarator(name, ptr_type, params, declarator_kind);
         basetype->copy_aux(r); // copy type-qualifier
+        if(is_restrict)
+            ptr_type->type_qualifier.push_back(KW_RESTRICT);
         return r;
     }
     TokenPtr tok = pp->get_token();
@@ -1975,7 +1859,7 @@ void Parser::read_declarator_params(vector<NodePtr>* params, vector<Type*>& para
             return;
         }
 
-        char* name;
+        char* name = nullptr;
         Type* type = read_decl_spec();
         type = read_declarator(&name, type, nullptr, typeonly ? DK_OPTIONAL : DK_CONCRETE);
         // C11 6.7.6.3p7: A declaration of a parameter as ‘‘array of type’’ shall be adjusted to 
@@ -2072,7 +1956,7 @@ void Parser::read_initializer(Type* type, vector<NodePtr>& init_list) {
     if(type->is_string_type() || pp->peek_token()->kind == '{') {
         read_initializer_list(init_list, type, 0);
 
-        auto cmp = [&](const pair<int, int>& x, const pair<int, int>& y) {
+        auto cmp = [](const pair<int, int>& x, const pair<int, int>& y) {
             return (x.first == y.first ? (x.second < y.second) : x.first < y.first);
         };
         map<pair<int, int>, shared_ptr<InitNode>, 
@@ -2173,17 +2057,16 @@ void Parser::read_struct_initializer_list(vector<NodePtr>& init_list, Type* type
                     }
                     char* name = tok->to_string();
                     int idx;
-                    field_type = get_struct_field_type(
-                            dynamic_cast<StructType*>(field_type)->fields, name, &idx);
+                    field_type = dynamic_cast<StructType*>(field_type)->get_field(name, &idx);
+                    if(!field_type) {
+                        errort(tok, "unknown field ‘%s’ specified in initializer", name);
+                        return;
+                    }
                     if(change_i) {
                         i = idx + 1;
                         change_i = false;
                     }
                     offset_offset += field_type->offset;
-                    if(!field_type) {
-                        errort(tok, "unknown field ‘%s’ specified in initializer", name);
-                        return;
-                    }
                 }
                 else if(tok->kind == '[') {
                     if(field_type->kind != TK_ARRAY) {
@@ -2258,13 +2141,12 @@ void Parser::read_array_initializer_list(vector<NodePtr>& init_list, Type* type,
                         errort(tok, "expected identifier");
                     }
                     char* name = tok->to_string();
-                    field_type = get_struct_field_type(
-                            dynamic_cast<StructType*>(field_type)->fields, name, nullptr);
-                    offset_offset += field_type->offset;
+                    field_type = dynamic_cast<StructType*>(field_type)->get_field(name);
                     if(!field_type) {
                         errort(tok, "unknown field ‘%s’ specified in initializer", name);
                         return;
                     }
+                    offset_offset += field_type->offset;
                 }
                 else if(tok->kind == '[') {
                     if(field_type->kind != TK_ARRAY) {
@@ -2546,13 +2428,22 @@ NodePtr Parser::read_switch_stmt(TokenPtr tok) {
     char* name = make_tmpname();
     NodePtr var = make_localvar_node(expr->first_token, expr->type, name, scope);
     list.push_back(make_binop(tok, '=', var, expr));
-    vector<CaseTuple>& cases = scope->get_cases();
-    for(size_t i = 0; i < cases.size(); ++i) {
-        list.push_back(make_switch_jump(var, cases[i]));
-    }
     char* default_label = scope->get_default_label();
     default_label = default_label ? default_label : end;
-    list.push_back(make_jump_node(tok, default_label, default_label));
+    vector<CaseTuple> cases = scope->get_cases();
+    sort(cases.begin(), cases.end(), [](const CaseTuple& x, const CaseTuple& y) {
+        return x.begin < y.begin;
+    });
+    // Negative case values of an unsigned switch quantity do not keep the order
+    if(!expr->type->is_unsigned || cases.empty() || cases[0].begin >= 0) {
+        list.push_back(make_switch_dispatch(var, cases, 0, cases.size(), default_label));
+    }
+    else {
+        for(size_t i = 0; i < cases.size(); ++i) {
+            list.push_back(make_switch_jump(var, cases[i]));
+        }
+        list.push_back(make_jump_node(tok, default_label, default_label));
+    }
     if(body) {
         list.push_back(body);
     }
@@ -2570,13 +2461,48 @@ NodePtr Parser::make_switch_jump(NodePtr var, const CaseTuple& c) {
         cond = make_binop(tok, P_EQ, var, make_int_node(tok, type_int, c.begin));
     }
     else {
-        NodePtr cond1 = make_binop(tok, P_LE, make_int_node(tok, type_int, c.begin), var);
-        NodePtr cond2 = make_binop(tok, P_LE, var, make_int_node(tok, type_int, c.end));
-        cond = make_binop(tok, P_LOGAND, cond1, cond2);
+        // begin <= var && var <= end  =>  (unsigned)(var - begin) <= end - begin
+        Type* utype = (var->type->size == 8) ? type_ulong : type_uint;
+        long long begin = (utype == type_uint) ? (unsigned int)c.begin : c.begin;
+        NodePtr diff = make_binop(tok, '-', convert(var, utype), make_int_node(tok, utype, begin));
+        cond = make_binop(tok, P_LE, diff, make_int_node(tok, utype, (long long)c.end - c.begin));
     }
     return make_if_node(tok, cond, make_jump_node(tok, c.label, c.label), nullptr);
 }
 
+// Dense case sets are dispatched through a jump table. Otherwise the sorted cases
+// are split in half by a compare until only a few are left to be tested one by one.
+#define SWITCH_LINEAR_MAX 3
+#define SWITCH_TABLE_DENSITY 4
+
+NodePtr Parser::make_switch_dispatch(NodePtr var, vector<CaseTuple>& cases, size_t lo, size_t hi, char* default_label) {
+    TokenPtr tok = var->first_token;
+    size_t n = hi - lo;
+    if(n > SWITCH_LINEAR_MAX) {
+        long long min = cases[lo].begin;
+        long long span = (long long)cases[hi - 1].end - min + 1;
+        if(span <= SWITCH_TABLE_DENSITY * (long long)n) {
+            vector<char*> labels(span, default_label);
+            for(size_t i = lo; i < hi; ++i) {
+                for(long long v = cases[i].begin; v <= cases[i].end; ++v) 
+                    labels[v - min] = cases[i].label;
+            }
+            return make_jump_table_node(tok, var, min, labels, default_label);
+        }
+        size_t mid = lo + n / 2;
+        NodePtr cond = make_binop(tok, '<', var, make_int_node(tok, type_int, cases[mid].begin));
+        return make_if_node(tok, cond, 
+            make_switch_dispatch(var, cases, lo, mid, default_label), 
+            make_switch_dispatch(var, cases, mid, hi, default_label));
+    }
+    vector<NodePtr> list;
+    for(size_t i = lo; i < hi; ++i) {
+        list.push_back(make_switch_jump(var, cases[i]));
+    }
+    list.push_back(make_jump_node(tok, default_label, default_label));
+    return make_compound_stmt_node(tok, list);
+}
+
 // while-statement
 NodePtr Parser::read_while_stmt(TokenPtr tok) {
     if(!pp->next('(')) {
@@ -2809,6 +2735,8 @@ void Parser::read_extern_decl() {
         bool is_func = is_type_name(tok) || tok->kind == '{';  
         // function define      
         if(is_func) {
+            // the definition changes its function type, which may be shared
+            type = type->copy();
             FuncType* func_type = dynamic_cast<FuncType*>(type);
             if(func_type->has_var_param && func_type->param_types.size() == 0) {
                 func_type->has_var_param = false;
@@ -2816,6 +2744,12 @@ void Parser::read_extern_decl() {
             if(func_type->is_old_style) {
                 read_oldstyle_param_type(func_type, params);
             }
+            // storage-class and function specifiers apply to the function, not its return type
+            func_type->storage_class = basetype->storage_class;
+            func_type->is_inline = basetype->is_inline;
+            func_type->is_noreturn = basetype->is_noreturn;
+            func_type->is_always_inline = basetype->is_always_inline;
+            func_type->is_noinline = basetype->is_noinline;
 
             make_globalvar_node(tok, func_type, name, scope);
             if(!pp->next('{')) {
@@ -2931,14 +2865,14 @@ decl_list_tail : decl decl_list_tail | 'empty'
 
 // ------------- used in old version ---------------
 // bool Parser::is_func_def() {
-//     pp->open_undo_mode();
+//     size_t pos = pp->mark();
 //     Type* basetype = read_decl_spec_opt();
 //     char* name;
 //     vector<NodePtr> params;
 //     read_declarator(&name, basetype, &params, DK_OPTIONAL);
 //     TokenPtr tok = pp->get_token();
 //     bool is_func = is_type_name(tok) || tok->kind == '{';
-//     pp->undo();
+//     pp->rewind(pos);
 //     return is_func;
 // }
 
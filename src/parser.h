@@ -58,45 +58,9 @@ public:
     // cast-expression
     NodePtr read_cast_expr();
 
-    // multiplicative-expression
-    NodePtr read_mul_expr();
-    NodePtr read_mul_expr_tail(NodePtr node);
-
-    // additive-expression
-    NodePtr read_add_expr();
-    NodePtr read_add_expr_tail(NodePtr node);
-
-    // shift-expression
-    NodePtr read_shift_expr();
-    NodePtr read_shift_expr_tail(NodePtr node);
-
-    // relational-expression
-    NodePtr read_relational_expr();
-    NodePtr read_relational_expr_tail(NodePtr node);
-
-    // equality-expression
-    NodePtr read_equal_expr();
-    NodePtr read_equal_expr_tail(NodePtr node);
-
-    // and-expression
-    NodePtr read_and_expr();
-    NodePtr read_and_expr_tail(NodePtr node);
-
-    // exclusive-or-expression
-    NodePtr read_xor_expr();
-    NodePtr read_xor_expr_tail(NodePtr node);
-
-    // inclusive-or-expression
-    NodePtr read_or_expr();
-    NodePtr read_or_expr_tail(NodePtr node);
-
-    // logical-and-expression
-    NodePtr read_land_expr();
-    NodePtr read_land_expr_tail(NodePtr node);
-
-    // logical-or-expression
-    NodePtr read_lor_expr();
-    NodePtr read_lor_expr_tail(NodePtr node);
+    // multiplicative-expression to logical-OR-expression
+    NodePtr read_binary_expr(int min_prec);
+    NodePtr read_binary_expr_tail(NodePtr node, int min_prec);
 
     // conditional-expression
     NodePtr read_cond_expr();
@@ -137,6 +101,9 @@ public:
     // typeof
     Type* read_typeof();
 
+    // GNU attribute
+    void read_attribute(bool* always_inline, bool* noinline);
+
     // declarator
     Type* read_declarator(char** name, Type* basetype, 
         std::vector<NodePtr>* params, int declarator_kind);
@@ -192,6 +159,7 @@ public:
     // switch-statement
     NodePtr read_switch_stmt(TokenPtr tok);
     NodePtr make_switch_jump(NodePtr var, const CaseTuple& c);
+    NodePtr make_switch_dispatch(NodePtr var, std::vector<CaseTuple>& cases, size_t lo, size_t hi, char* default_label);
 
     // while-statement
     NodePtr read_while_stmt(TokenPtr tok);
@@ -93,6 +93,7 @@ static TokenPtr stringize(TokenPtr templ, vector<TokenPtr>& args) {
         }
         buf.write("%s", args[i]->to_string());
     }
+    buf.write('\0');
     TokenPtr str = make_string(buf.data(), buf.size(), ENC_NONE, templ->get_pos());
     templ->copy_aux(str);
     return str;
@@ -363,12 +364,11 @@ bool Preprocessor::read_const_expr() {
 void Preprocessor::skip_cond_incl() {
     int level = 0;
     while(true) {
+        TokenPtr hash = lexer->skip_to_directive();
+        if(!hash) {
+            error("unterminated conditional directive");
+        }
         TokenPtr tok = lexer->get_token();
-        if(!tok->begin_of_line || !tok->is_keyword('#')) 
-            continue;
-        
-        TokenPtr hash = tok;
-        tok = lexer->get_token();
         if(level == 0 && (tok->is_ident("elif") || tok->is_ident("else") || tok->is_ident("endif"))) {
             lexer->unget_token(tok);
             lexer->unget_token(hash);
@@ -580,7 +580,7 @@ void Preprocessor::read_object_macro(TokenPtr name) {
     }
     hashhash_check(body);
     macros[name->to_string()] = 
-        shared_ptr<ObjectMacro>(new ObjectMacro(body));
+        arena_make<ObjectMacro>(body);
 }
 
 void Preprocessor::read_function_macro(TokenPtr name) {
@@ -590,7 +590,7 @@ void Preprocessor::read_function_macro(TokenPtr name) {
     bool has_var_param = false;
 
     auto make_macro_param_token = [](int pos, bool is_var_param) {
-        return shared_ptr<MacroParamToken>(new MacroParamToken(pos, is_var_param));
+        return arena_make<MacroParamToken>(pos, is_var_param);
     };
 
     // read macro parameters
@@ -645,7 +645,7 @@ void Preprocessor::read_function_macro(TokenPtr name) {
 
     hashhash_check(body);
     macros[name->to_string()] = 
-        shared_ptr<FunctionMacro>(new FunctionMacro(body, params.size(), has_var_param));
+        arena_make<FunctionMacro>(body, params.size(), has_var_param);
 }
 
 void Preprocessor::read_define() {
@@ -696,10 +696,10 @@ void Preprocessor::read_line() {
     else if(tok->kind != TNEWLINE) {
         errort(tok, "expected newline or a source name");
     }
-    File& current_file = lexer->get_fileset().current_file();
-    current_file.row = line;
+    FileSet& fileset = lexer->get_fileset();
+    fileset.set_row(line);
     if(filename)
-        current_file.name = filename;
+        fileset.current_file().name = filename;
 }
 
 
@@ -763,7 +763,7 @@ void Preprocessor::read_pragma() {
 // C11 6.10.8: predefine macro names
 void Preprocessor::init_predefined_macro() {
     auto make_predefined_macro = [](std::function<TokenPtr(TokenPtr)> handler) {
-        return shared_ptr<PredefinedMacro>(new PredefinedMacro(handler));
+        return arena_make<PredefinedMacro>(handler);
     };
     auto subst_string = [&](char* str, TokenPtr tok) {
         TokenPtr subst_tok = make_string(str, strlen(str)+1, ENC_NONE, tok->get_pos());
@@ -905,56 +905,105 @@ TokenPtr Preprocessor::get_token_aux() {
     return tok;
 }
 
-TokenPtr Preprocessor::get_token() {
-    TokenPtr tok = get_token_aux();
+TokenPtr Preprocessor::read_token() {
+    TokenPtr tok;
+    if(pending)
+        swap(tok, pending);
+    else
+        tok = get_token_aux();
     if(tok->kind == TSTRING) {
+        vector<shared_ptr<String>> pieces(1, dynamic_pointer_cast<String>(tok));
         while(true) {
             TokenPtr tok2 = get_token_aux();
             if(tok2->kind != TSTRING) {
-                unget_token(tok2);
+                pending = tok2;
                 break;
             }
-
-            Buffer buffer;
-            shared_ptr<String> stok = dynamic_pointer_cast<String>(tok);
-            shared_ptr<String> stok2 = dynamic_pointer_cast<String>(tok2);
-            buffer.write("%s%s", stok->value, stok2->value);
-            stok->value = buffer.data();
-            stok->size = stok->size + stok2->size;
+            pieces.push_back(dynamic_pointer_cast<String>(tok2));
         }
-    }
-    if(allow_undo) {
-        record.push_back(tok);
+        if(pieces.size() > 1)
+            tok = concat_strings(pieces);
     }
     return tok;
 }
 
-void Preprocessor::unget_token(TokenPtr tok) {
-    lexer->unget_token(tok);
-    if(allow_undo) {
-        assert(record.size() > 0);
-        record.pop_back();
+// C11 6.4.5p5: adjacent string literal tokens are concatenated into a single 
+// multibyte character sequence. If any of the tokens has an encoding prefix, 
+// the resulting sequence is treated as having the same prefix.
+TokenPtr Preprocessor::concat_strings(vector<shared_ptr<String>>& pieces) {
+    int enc = ENC_NONE;
+    int size = 1;
+    for(auto& piece:pieces) {
+        if(piece->encode_method != ENC_NONE) {
+            if(enc != ENC_NONE && enc != piece->encode_method) 
+                errort(piece, "unsupported non-standard concatenation of string literals");
+            enc = piece->encode_method;
+        }
+        // each size counts the terminating '\0'
+        if(piece->size > 1)
+            size += piece->size - 1;
+    }
+    char* value = (char*)arena_alloc(Arena::current, size);
+    char* p = value;
+    for(auto& piece:pieces) {
+        if(piece->size > 1) {
+            memcpy(p, piece->value, piece->size - 1);
+            p += piece->size - 1;
+        }
+    }
+    *p = '\0';
+    // the first piece may belong to a macro body, so it is left as it is
+    shared_ptr<String> tok = dynamic_pointer_cast<String>(pieces[0]->copy());
+    tok->value = value;
+    tok->size = size;
+    tok->encode_method = enc;
+    return tok;
+}
+
+TokenPtr Preprocessor::get_token() {
+    if(pos == buf.size()) {
+        if(marks == 0) {
+            buf.clear();
+            pos = 0;
+        }
+        buf.push_back(read_token());
     }
+    return buf[pos++];
 }
 
-TokenPtr Preprocessor::peek_token() {
-    TokenPtr tok = get_token();
-    unget_token(tok);
-    return tok;
+void Preprocessor::unget_token(TokenPtr tok) {
+    if(pos > 0 && buf[pos-1] == tok)
+        --pos;
+    else
+        buf.insert(buf.begin() + pos, tok);
+}
+
+TokenPtr Preprocessor::peek_token(int n) {
+    while(buf.size() <= pos + n) 
+        buf.push_back(read_token());
+    return buf[pos + n];
 }
 
 bool Preprocessor::next(int kind) {
-    TokenPtr tok = get_token();
-    if(tok->kind == kind) 
+    if(peek_token()->kind == kind) {
+        ++pos;
         return true;
-    unget_token(tok);
+    }
     return false;
 }
 
-void Preprocessor::undo() {
-    allow_undo = false;
-    while(!record.empty()) {
-        unget_token(record.back());
-        record.pop_back();
-    }
+size_t Preprocessor::mark() {
+    ++marks;
+    return pos;
+}
+
+void Preprocessor::rewind(size_t mark) {
+    assert(marks > 0 && mark <= pos);
+    pos = mark;
+    --marks;
+}
+
+void Preprocessor::unmark() {
+    assert(marks > 0);
+    --marks;
 }
\ No newline at end of file
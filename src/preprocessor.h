@@ -18,7 +18,7 @@ public:
         Token(TMACRO_PARAM), position(pos), is_var_param(is_var_param) {}
 
     virtual std::shared_ptr<Token> copy() {
-        std::shared_ptr<Token> tok = std::shared_ptr<Token>(new MacroParamToken(position, is_var_param));
+        std::shared_ptr<Token> tok = arena_make<MacroParamToken>(position, is_var_param);
         copy_aux(tok);
         return tok;
     }
@@ -85,13 +85,16 @@ public:
 
     TokenPtr get_token();
     void unget_token(TokenPtr tok);
-    TokenPtr peek_token();
+    // the n-th token after the next one, without reading it
+    TokenPtr peek_token(int n = 0);
     bool next(int kind);
 
-    void add_include_path(char* path) { std_include_path.push_back(path); }
+    // keep the tokens read from here on, until rewind() goes back or unmark() drops them
+    size_t mark();
+    void rewind(size_t mark);
+    void unmark();
 
-    void open_undo_mode() { allow_undo = true; }
-    void undo();
+    void add_include_path(char* path) { std_include_path.push_back(path); }
 
 private:
     // ------------------------ macro expansion ---------------------------
@@ -155,6 +158,8 @@ private:
     
     TokenPtr maybe_convert_to_keyword(TokenPtr tok);
     TokenPtr get_token_aux();
+    TokenPtr read_token();
+    TokenPtr concat_strings(std::vector<std::shared_ptr<String>>& pieces);
 
 private:
     Lexer* lexer;
@@ -165,6 +170,14 @@ private:
 
     std::map<char*, int, cstr_cmp> keywords;
 
-    bool allow_undo = false;
-    std::vector<TokenPtr> record;
+    /*
+    Tokens between the preprocessor and the parser, fully processed. buf[pos] 
+    is the next token. Tokens before pos are dropped once read, unless marked, 
+    so peeking and ungetting never process a token twice.
+    */
+    std::vector<TokenPtr> buf;
+    size_t pos = 0;
+    int marks = 0;
+    // read after a string literal to see if another one follows
+    TokenPtr pending;
 };
\ No newline at end of file
@@ -3,22 +3,23 @@
 #include "scope.h"
 
 std::shared_ptr<Node> Scope::get(char* name) {
-    for(int i = local_envs.size()-1; i >= 0; --i) {
-        if(local_envs[i].find(name) != local_envs[i].end()) {
-            return local_envs[i][name];
-        }
-    }
-    if(global_env.find(name) != global_env.end()) {
-        return global_env[name];
+    auto iter = env.find(name);
+    if(iter == env.end())
+        return nullptr;
+    auto& chain = iter->second;
+    for(int i = chain.size()-1; i >= 0; --i) {
+        if(chain[i].level == 0 || chain[i].level > hidden)
+            return chain[i].node;
     }
     return nullptr;
 }
 
 std::shared_ptr<Node> Scope::get_local(char* name) {
-    if(local_envs.back().find(name) != local_envs.back().end()) {
-        return local_envs.back()[name];
-    }
-    return nullptr;
+    auto iter = env.find(name);
+    if(iter == env.end() || iter->second.empty())
+        return nullptr;
+    Binding& b = iter->second.back();
+    return (b.level == depth && depth > hidden) ? b.node : nullptr;
 }
 
 
@@ -52,11 +53,17 @@ std::vector<std::shared_ptr<Node>> Scope::get_local_vars() {
 
 
 void Scope::add(char* name, std::shared_ptr<Node> val) {
-    if(local_envs.size() > 0) {
-        local_envs.back()[name] = val;
+    if(!islocal()) {
+        add_global(name, val);
+        return;
     }
-    else 
-        global_env[name] = val;
+    auto& chain = env[name];
+    if(!chain.empty() && chain.back().level == depth) {
+        chain.back().node = val;
+        return;
+    }
+    chain.push_back({depth, val});
+    bound[depth-1].push_back(name);
 }
 
 void Scope::add_local_var(std::shared_ptr<Node> var) {
@@ -64,7 +71,11 @@ void Scope::add_local_var(std::shared_ptr<Node> var) {
 }
 
 void Scope::add_global(char* name, std::shared_ptr<Node> val) {
-    global_env[name] = val;
+    auto& chain = env[name];
+    if(!chain.empty() && chain.front().level == 0)
+        chain.front().node = val;
+    else
+        chain.insert(chain.begin(), {0, val});
 } 
 
 void Scope::add_switch_case(CaseTuple c) {
@@ -76,7 +87,9 @@ void Scope::set_switch_default(char* label) {
 }
 
 void Scope::in() {
-    local_envs.push_back(std::map<char*, std::shared_ptr<Node>, cstr_cmp>());
+    ++depth;
+    if((int)bound.size() < depth)
+        bound.resize(depth);
 }
 
 void Scope::in(FuncType* func) {
@@ -85,9 +98,17 @@ void Scope::in(FuncType* func) {
 }
 
 void Scope::out() {
-    if(local_envs.size() > 0)
-        local_envs.pop_back();
-    if(local_envs.size() == 0) {
+    if(depth > 0) {
+        for(auto name:bound[depth-1]) {
+            auto iter = env.find(name);
+            iter->second.pop_back();
+            if(iter->second.empty())
+                env.erase(iter);
+        }
+        bound[depth-1].clear();
+        --depth;
+    }
+    if(depth == 0) {
         local_vars.clear();
     }
 }
@@ -123,13 +144,13 @@ Scope* Scope::copy() {
 }
 
 void Scope::clear_local() {
-    assert(local_envs_backup.size() == 0);
-    swap(local_envs, local_envs_backup);
+    assert(hidden == 0);
+    hidden = depth;
 }
 
 void Scope::recover_local() {
-    assert(local_envs.size() == 0);
-    swap(local_envs, local_envs_backup);
+    assert(depth == hidden);
+    hidden = 0;
 }
 
 void Scope::clear_local_var() {
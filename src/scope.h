@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 #include "ast.h"
@@ -18,8 +19,9 @@ class Scope {
 public:
     Scope() {}
     Scope(Scope* scope): 
-        global_env(scope->global_env), 
-        local_envs(scope->local_envs) {}
+        env(scope->env), 
+        bound(scope->bound),
+        depth(scope->depth) {}
 
     std::shared_ptr<Node> get(char* name);
     std::shared_ptr<Node> get_local(char* name);
@@ -44,7 +46,7 @@ public:
     void in_switch(char* lbreak);
     void out_switch();
 
-    bool islocal() { return local_envs.size() > 0; }
+    bool islocal() { return depth > hidden; }
     bool is_in_loop() { return breaks.size() > 0; }
     bool is_in_switch() { return defaults.size() > 0; }
 
@@ -55,9 +57,21 @@ public:
     Scope* copy();
 
 private:
-    std::map<char*, std::shared_ptr<Node>, cstr_cmp> global_env;
-    std::vector<std::map<char*, std::shared_ptr<Node>, cstr_cmp>> local_envs;
-    std::vector<std::map<char*, std::shared_ptr<Node>, cstr_cmp>> local_envs_backup;
+    struct Binding {
+        int level;  // 0 for file scope
+        std::shared_ptr<Node> node;
+    };
+
+    /*
+    One table for all scopes. Each name maps to its bindings from the outermost
+    to the innermost, so the visible one is at the back. bound[i] lists the
+    names bound at level i+1 to undo them when the level is left.
+    */
+    std::unordered_map<char*, std::vector<Binding>, cstr_hash, cstr_eq> env;
+    std::vector<std::vector<char*>> bound;
+    int depth = 0;
+    // levels 1 to hidden are invisible while a static local is initialized
+    int hidden = 0;
 
     std::vector<std::shared_ptr<Node>> local_vars;
 
@@ -3,51 +3,51 @@
 #include "token.h"
 
 std::shared_ptr<Token> make_token(int kind, const Pos& pos) {
-    Token* tok = new Token(kind);
+    std::shared_ptr<Token> tok = arena_make<Token>(kind);
     tok->filename =  pos.filename;
     tok->row = pos.row;
     tok->col = pos.col;
-    return std::shared_ptr<Token>(tok);
+    return tok;
 }
 
 std::shared_ptr<Token> make_keyword(int kind, const Pos& pos) {
-    Token* tok = new Keyword(kind);
+    std::shared_ptr<Token> tok = arena_make<Keyword>(kind);
     tok->filename =  pos.filename;
     tok->row = pos.row;
     tok->col = pos.col;
-    return std::shared_ptr<Token>(tok);
+    return tok;
 }
 
 std::shared_ptr<Token> make_ident(char* name, const Pos& pos) {
-    Token* tok = new Ident(name);
+    std::shared_ptr<Token> tok = arena_make<Ident>(name);
     tok->filename =  pos.filename;
     tok->row = pos.row;
     tok->col = pos.col;
-    return std::shared_ptr<Token>(tok);
+    return tok;
 }
 
 std::shared_ptr<Token> make_number(char* s, const Pos& pos) {
-    Token* tok = new Number(s);
+    std::shared_ptr<Token> tok = arena_make<Number>(s);
     tok->filename =  pos.filename;
     tok->row = pos.row;
     tok->col = pos.col;
-    return std::shared_ptr<Token>(tok);
+    return tok;
 }
 
 std::shared_ptr<Token> make_char(char c, int enc, const Pos& pos) {
-    Token* tok = new Char(c, enc);
+    std::shared_ptr<Token> tok = arena_make<Char>(c, enc);
     tok->filename =  pos.filename;
     tok->row = pos.row;
     tok->col = pos.col;
-    return std::shared_ptr<Token>(tok);
+    return tok;
 }
 
 std::shared_ptr<Token> make_string(char* s, int size, int enc, const Pos& pos) {
-    Token* tok = new String(s, size, enc);
+    std::shared_ptr<Token> tok = arena_make<String>(s, size, enc);
     tok->filename =  pos.filename;
     tok->row = pos.row;
     tok->col = pos.col;
-    return std::shared_ptr<Token>(tok);
+    return tok;
 }
 
 bool Token::is_keyword(int k) {
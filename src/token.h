@@ -4,6 +4,7 @@
 #include <set>
 #include "file.h"
 #include "utils.h"
+#include "arena.h"
 
 /*
 According to C11 6.4:
@@ -38,7 +39,7 @@ public:
         tok->hideset = hideset;
     }
     virtual std::shared_ptr<Token> copy() {
-        std::shared_ptr<Token> tok = std::shared_ptr<Token>(new Token(kind));
+        std::shared_ptr<Token> tok = arena_make<Token>(kind);
         copy_aux(tok);
         return tok;
     }
@@ -83,7 +84,7 @@ public:
     virtual char* to_string();
 
     virtual std::shared_ptr<Token> copy() {
-        std::shared_ptr<Token> tok = std::shared_ptr<Token>(new Keyword(kind));
+        std::shared_ptr<Token> tok = arena_make<Keyword>(kind);
         copy_aux(tok);
         return tok;
     }
@@ -95,7 +96,7 @@ public:
     virtual char* to_string();
 
     virtual std::shared_ptr<Token> copy() {
-        std::shared_ptr<Token> tok = std::shared_ptr<Token>(new Ident(name));
+        std::shared_ptr<Token> tok = arena_make<Ident>(name);
         copy_aux(tok);
         return tok;
     }
@@ -110,7 +111,7 @@ public:
     virtual char* to_string();
 
     virtual std::shared_ptr<Token> copy() {
-        std::shared_ptr<Token> tok = std::shared_ptr<Token>(new Number(value));
+        std::shared_ptr<Token> tok = arena_make<Number>(value);
         copy_aux(tok);
         return tok;
     }
@@ -132,7 +133,7 @@ public:
     virtual char* to_string();
 
     virtual std::shared_ptr<Token> copy() {
-        std::shared_ptr<Token> tok = std::shared_ptr<Token>(new Char(character, encode_method));
+        std::shared_ptr<Token> tok = arena_make<Char>(character, encode_method);
         copy_aux(tok);
         return tok;
     }
@@ -148,7 +149,7 @@ public:
     virtual char* to_string();
 
     virtual std::shared_ptr<Token> copy() {
-        std::shared_ptr<Token> tok = std::shared_ptr<Token>(new String(value, size, encode_method));
+        std::shared_ptr<Token> tok = arena_make<String>(value, size, encode_method);
         copy_aux(tok);
         return tok;
     }
@@ -34,11 +34,16 @@ Type* make_number_type(int kind, bool is_unsigned) {
 }
 
 Type* make_ptr_type(Type* type) {
+    if(TypeTable::current)
+        return TypeTable::current->ptr_type(type);
     Type* ty = new PtrType(type);
     return ty;
 }
 
+// incomplete arrays are completed in place, so they are never shared
 Type* make_array_type(Type* type, int length) {
+    if(TypeTable::current && length >= 0)
+        return TypeTable::current->array_type(type, length);
     Type* ty = new ArrayType(type, length);
     return ty;
 }
@@ -50,10 +55,59 @@ Type* make_struct_type(int kind, char* name) {
 }
 
 Type* make_func_type(Type* return_type, std::vector<Type*> param_types, bool has_var_param, bool is_old_style) {
+    if(TypeTable::current)
+        return TypeTable::current->func_type(return_type, param_types, has_var_param, is_old_style);
     Type* ty = new FuncType(return_type, param_types, has_var_param, is_old_style);
     return ty;
 }
 
+// type table
+thread_local TypeTable* TypeTable::current = nullptr;
+
+Type* TypeTable::ptr_type(Type* type) {
+    Type*& ty = ptr_types[type];
+    if(!ty) {
+        ty = new PtrType(type);
+        ty->canonical = ty;
+    }
+    return ty;
+}
+
+Type* TypeTable::array_type(Type* type, int length) {
+    Type*& ty = array_types[std::make_pair(type, length)];
+    if(!ty) {
+        ty = new ArrayType(type, length);
+        ty->canonical = ty;
+    }
+    return ty;
+}
+
+Type* TypeTable::func_type(Type* return_type, std::vector<Type*>& param_types, bool has_var_param, bool is_old_style) {
+    Type*& ty = func_types[std::make_tuple(return_type, param_types, has_var_param, is_old_style)];
+    if(!ty) {
+        ty = new FuncType(return_type, param_types, has_var_param, is_old_style);
+        ty->canonical = ty;
+    }
+    return ty;
+}
+
+void StructType::build_field_index() {
+    field_index.clear();
+    field_index.reserve(fields.size());
+    for(size_t i = 0; i < fields.size(); ++i) {
+        // the first of duplicate names wins
+        field_index.emplace(fields[i].first, i);
+    }
+}
+
+Type* StructType::get_field(char* name, int* index) {
+    auto iter = field_index.find(name);
+    if(iter == field_index.end())
+        return nullptr;
+    if(index) *index = iter->second;
+    return fields[iter->second].second;
+}
+
 bool Type::is_int_type() {
     return (kind >= TK_BOOL && kind <= TK_LONG_LONG);
 }
@@ -126,12 +180,14 @@ bool Type::is_compatible(Type* type) {
 }
 
 bool PtrType::is_compatible(Type* type) {
+    if(is_same(type)) return true;
     if(type->kind != TK_PTR) return false;
     PtrType* ty = dynamic_cast<PtrType*>(type);
     return ptr_type->is_compatible(ty->ptr_type);
 }
 
 bool ArrayType::is_compatible(Type* type) {
+    if(is_same(type)) return true;
     if(type->kind != TK_ARRAY) return false;
     ArrayType* ty = dynamic_cast<ArrayType*>(type);
     return (length == ty->length) && (elem_type->is_compatible(ty->elem_type));
@@ -153,6 +209,7 @@ bool StructType::is_compatible(Type* type) {
 }
 
 bool FuncType::is_compatible(Type* type) {
+    if(is_same(type)) return true;
     if(type->kind != kind) return false;
     FuncType* ty = dynamic_cast<FuncType*>(type);
     if(!return_type->is_compatible(ty->return_type)) {
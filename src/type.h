@@ -2,8 +2,12 @@
 
 #include <map>
 #include <vector>
+#include <tuple>
+#include <unordered_map>
 #include <assert.h>
 #include "error.h"
+#include "utils.h"
+#include "arena.h"
 
 /*
 C11 6.2.5 Types
@@ -39,6 +43,10 @@ public:
 
     virtual ~Type() {}
 
+    // types live as long as the translation unit, in its arena
+    static void* operator new(size_t size) { return arena_alloc(Arena::current, size); }
+    static void operator delete(void*) {}
+
     virtual char* to_string();
 
     virtual Type* copy() { 
@@ -56,8 +64,14 @@ public:
         type->type_qualifier = type_qualifier;
         type->is_inline = is_inline;
         type->is_noreturn = is_noreturn;
+        type->is_always_inline = is_always_inline;
+        type->is_noinline = is_noinline;
+        type->canonical = canonical;
     }
 
+    // types interned from the same description are the same object
+    bool is_same(Type* type) { return canonical && canonical == type->canonical; }
+
     bool is_int_type();
     bool is_float_type();
     bool is_arith_type();
@@ -87,8 +101,15 @@ public:
     bool is_inline = false;
     bool is_noreturn = false;
 
+    // __attribute__((always_inline)) and __attribute__((noinline))
+    bool is_always_inline = false;
+    bool is_noinline = false;
+
     // to avoid multiple copies
     bool from_copy = false;
+
+    // the interned type this one is, or was copied from
+    Type* canonical = nullptr;
 };
 
 class NumType: public Type {
@@ -180,12 +201,19 @@ public:
         type->align = align;
         copy_aux(type);
         type->fields = fields;
+        type->field_index = field_index;
         type->from_copy = true;
         return type;
     }
+
+    // index the fields by name once the struct is complete
+    void build_field_index();
+    Type* get_field(char* name, int* index = nullptr);
 public:
     char* name;
+    // members of anonymous structs and unions are flattened into fields
     std::vector<std::pair<char*, Type*>> fields;
+    std::unordered_map<char*, int, cstr_hash, cstr_eq> field_index;
 };
 
 class FuncType: public Type {
@@ -237,3 +265,30 @@ Type* make_array_type(Type* type, int length);
 Type* make_struct_type(int kind, char* name = nullptr);
 Type* make_func_type(Type* return_type, std::vector<Type*> param_types, bool has_var_arg, bool is_old_style);
 
+/*
+Derived types of one translation unit, interned by their description so that 
+each pointer, complete array and function type is made only once. Interned 
+types are shared and must be copied before changing them.
+*/
+class TypeTable {
+public:
+    TypeTable() {}
+    ~TypeTable() {
+        if(current == this) current = nullptr;
+    }
+
+    Type* ptr_type(Type* type);
+    Type* array_type(Type* type, int length);
+    Type* func_type(Type* return_type, std::vector<Type*>& param_types, bool has_var_param, bool is_old_style);
+
+    // the table of the translation unit being compiled on this thread, null outside of one
+    static thread_local TypeTable* current;
+
+private:
+    using FuncKey = std::tuple<Type*, std::vector<Type*>, bool, bool>;
+
+    std::map<Type*, Type*> ptr_types;
+    std::map<std::pair<Type*, int>, Type*> array_types;
+    std::map<FuncKey, Type*> func_types;
+};
+
@@ -15,7 +15,23 @@ char* quote_string(char* s);
 char* quote_string(char* s, int len);
 
 struct cstr_cmp {
-    bool operator()(const char* a, const char* b) {
+    bool operator()(const char* a, const char* b) const {
         return ::strcmp(a, b) < 0;
     }
+};
+
+// FNV-1a, for unordered containers keyed by C string
+struct cstr_hash {
+    size_t operator()(const char* s) const {
+        size_t h = 14695981039346656037ULL;
+        for(; *s; ++s)
+            h = (h ^ (unsigned char)*s) * 1099511628211ULL;
+        return h;
+    }
+};
+
+struct cstr_eq {
+    bool operator()(const char* a, const char* b) const {
+        return ::strcmp(a, b) == 0;
+    }
 };
\ No newline at end of file
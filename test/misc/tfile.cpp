@@ -16,8 +16,9 @@ int main() {
     int c = fs.get_chr();
     fs.unget_chr(c);
     while(c != EOF) {
-        File& f = fs.current_file();
-        cout << f.name << " " << f.row << " " << f.col << endl;
+        int row, col;
+        fs.get_pos(&row, &col);
+        cout << fs.current_file().name << " " << row << " " << col << endl;
         c = fs.get_chr();
     }
 }
\ No newline at end of file
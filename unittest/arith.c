@@ -34,6 +34,74 @@ void test_binary() {
     EXPECT_INT((1,2,3,4), 4);
 }
 
+void test_operand() {
+    int a = -5, b = 3;
+    long c = 1099511627776, d = -2;
+    unsigned u = 4294967295u;
+    EXPECT_INT(a+1, -4);
+    EXPECT_INT(a*b, -15);
+    EXPECT_INT(a&b, 3);
+    EXPECT_INT(a|b, -5);
+    EXPECT_INT(a<<2, -20);
+    EXPECT_INT(a>>1, -3);
+    EXPECT_INT(u>>28, 15);
+    EXPECT_INT(u&b, 3);
+    EXPECT_INT(c+d, 1099511627774);
+    EXPECT_INT(c/d, -549755813888);
+    EXPECT_INT(c%7, 2);
+    EXPECT_TRUE(a<0);
+    EXPECT_TRUE(a!=b);
+    EXPECT_TRUE(c>d);
+    EXPECT_FALSE(u<b);
+}
+
+void test_const_operand() {
+    int a = -100, b = 12345;
+    unsigned u = 4000000000u;
+    long l = -1099511627776;
+    int arr[8], *p = arr + 6;
+    EXPECT_INT(a*9, -900);
+    EXPECT_INT(10*b, 123450);
+    EXPECT_INT(a/8, -12);
+    EXPECT_INT(a%8, -4);
+    EXPECT_INT(a/7, -14);
+    EXPECT_INT(a%-7, -2);
+    EXPECT_INT(b/10, 1234);
+    EXPECT_INT(b%10, 5);
+    EXPECT_INT(u/3, 1333333333);
+    EXPECT_INT(u%7, 3);
+    EXPECT_INT(u/16, 250000000);
+    EXPECT_INT(l/1000, -1099511627);
+    EXPECT_INT(l%1000, -776);
+    EXPECT_INT(p-arr, 6);
+    EXPECT_INT((p-4)-arr, 2);
+    long wide = (char*)(p + (unsigned)-1) - (char*)p;
+    EXPECT_INT(wide, 17179869180);
+    wide = (char*)(p - -1u) - (char*)p;
+    EXPECT_INT(wide, -17179869180);
+    wide = (char*)(p + (unsigned char)-1) - (char*)p;
+    EXPECT_INT(wide, 1020);
+    wide = (char*)(p + (int)0x100000001) - (char*)p;
+    EXPECT_INT(wide, 4);
+}
+
+void test_fold() {
+    int a = 7, n = 0;
+    const int N = 10;
+    EXPECT_INT(2*3+4, 10);
+    EXPECT_INT(-7/2, -3);
+    EXPECT_INT(0u-1 > 0, 1);
+    EXPECT_INT((unsigned char)300, 44);
+    EXPECT_INT(a+1+2+3, 13);
+    EXPECT_INT(a*1+0, 7);
+    EXPECT_INT((n++, 0) && n++, 0);
+    EXPECT_INT(n, 1);
+    EXPECT_INT(N*N, 100);
+    EXPECT_DOUBLE(1.5+2.25, 3.75);
+    if(0) n = 5; else n = 6;
+    EXPECT_INT(n, 6);
+}
+
 void test_ternary() {
     int a = 1, b = 2;
     EXPECT_DOUBLE(a>b?1.0:2.0, 2.0);
@@ -42,6 +110,9 @@ void test_ternary() {
 int main() {
     test_unary();
     test_binary();
+    test_operand();
+    test_const_operand();
+    test_fold();
     test_ternary();
     print_result(); 
 }
\ No newline at end of file
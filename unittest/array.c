@@ -21,7 +21,40 @@ void test_array() {
     EXPECT_INT(b[1][1], 3);
 }
 
+static void add_scaled(float* a, float* b, float k, int n) {
+    for(int i = 0; i < n; i++) 
+        a[i] = a[i] + b[i] * k;
+}
+
+static int dot(int* restrict a, int* restrict b, int n) {
+    int s = 0;
+    for(int i = 0; i < n; i++) 
+        s += a[i] * b[i];
+    return s;
+}
+
+void test_vectorize() {
+    float x[11], y[11];
+    int a[19], b[19], i;
+    char c[35];
+    for(i = 0; i < 11; i++) { x[i] = i; y[i] = 2 * i; }
+    add_scaled(x, y, 0.5f, 11);
+    EXPECT_INT((int)x[10], 20);
+    add_scaled(x + 1, x, 1.0f, 10);
+    EXPECT_INT((int)x[3], 12);
+    for(i = 0; i < 19; i++) { a[i] = i; b[i] = i - 9; }
+    EXPECT_INT(dot(a, b, 19), 570);
+    EXPECT_INT(dot(a, b, 3), -22);
+    for(i = 0; i < 34; i++) c[i] = 'a' + i % 2;
+    c[34] = 0;
+    EXPECT_INT(c[33], 'b');
+    for(i = 1; i < 34; i++) c[i] = c[i] ^ 32;
+    EXPECT_INT(c[0], 'a');
+    EXPECT_INT(c[32], 'A');
+}
+
 int main() {
     test_array();
+    test_vectorize();
     print_result(); 
 }
\ No newline at end of file
@@ -19,7 +19,131 @@ void test_iteration() {
     EXPECT_INT(i, 300);
 }
 
+int dense_switch(int x) {
+    switch(x) {
+    case 0: return 10;
+    case 1: return 11;
+    case 2: case 3: return 23;
+    case 5: x += 1;
+    case 6: return x * 2;
+    case 8 ... 10: return 80;
+    default: return -1;
+    }
+}
+
+int sparse_switch(unsigned x) {
+    switch(x) {
+    case 1: return 1;
+    case 100: return 2;
+    case 1000: return 3;
+    case 10000: return 4;
+    case 100000: return 5;
+    case 'A' ... 'Z': return 6;
+    }
+    return 0;
+}
+
+void test_switch() {
+    EXPECT_INT(dense_switch(-1), -1);
+    EXPECT_INT(dense_switch(0), 10);
+    EXPECT_INT(dense_switch(3), 23);
+    EXPECT_INT(dense_switch(4), -1);
+    EXPECT_INT(dense_switch(5), 12);
+    EXPECT_INT(dense_switch(6), 12);
+    EXPECT_INT(dense_switch(9), 80);
+    EXPECT_INT(dense_switch(11), -1);
+    EXPECT_INT(sparse_switch(1), 1);
+    EXPECT_INT(sparse_switch(100), 2);
+    EXPECT_INT(sparse_switch(10000), 4);
+    EXPECT_INT(sparse_switch(64), 0);
+    EXPECT_INT(sparse_switch(90), 6);
+    EXPECT_INT(sparse_switch(-1), 0);
+}
+
+int dead_branches(int x) {
+    int r = 1;
+    r = x * 2;
+    if(0) r = 100;
+    if(x > 0) return r;
+    else return -r;
+    r = 7;
+}
+
+int skip_into(int n) {
+    int s = 0;
+    goto next;
+    s = 100;
+next:
+    if(0) {
+    again:
+        s += 10;
+        if(s > 30) return s;
+    }
+    s += n;
+    goto again;
+}
+
+static int peek_int(int* p) {
+    return *p;
+}
+
+// stores read through a pointer before being overwritten are live
+int store_through(int n) {
+    int x;
+    int* p = &x;
+    int y, z;
+    x = 5;
+    y = *p;
+    x = 6;
+    x = n;
+    z = peek_int(p);
+    x = 7;
+    return y * 100 + z * 10 + x;
+}
+
+void test_dead_code() {
+    EXPECT_INT(store_through(3), 537);
+    EXPECT_INT(dead_branches(3), 6);
+    EXPECT_INT(dead_branches(-4), 8);
+    EXPECT_INT(skip_into(1), 33);
+    EXPECT_INT(skip_into(25), 35);
+}
+
+int skipped_groups() {
+    int n = 0;
+#if 0
+    it's not a token stream: "unbalanced
+    /* #endif
+    */
+    char* s = "#endif";
+    #if nested
+    #else
+    #endif
+    // #endif
+#elif 1
+    n += 1;
+#endif
+#ifdef NOT_DEFINED
+    #ifndef ALSO \
+    #endif
+    #endif
+#else
+    n += 10;
+#endif
+    /* comment */ # if 0
+    n += 100;
+  %:endif
+    return n;
+}
+
+void test_skip_group() {
+    EXPECT_INT(skipped_groups(), 11);
+}
+
 int main() {
     test_iteration();
+    test_switch();
+    test_dead_code();
+    test_skip_group();
     print_result(); 
 }
\ No newline at end of file
@@ -74,9 +74,40 @@ void test_float3() {
     EXPECT_DOUBLE(*d, 1.0);
 }
 
+float gf = 0.75f;
+double gd = 1.25;
+
+void test_float4() {
+    double a = 7.0, b = 2.0, zero = 0.0;
+    float f = 4.0f;
+    EXPECT_DOUBLE(a - (b - (a / (b - (a - (b / (a - (b - (a / (b + (a - 3.5)))))))))), 
+        7.0 - (2.0 - (7.0 / (2.0 - (7.0 - (2.0 / (7.0 - (2.0 - (7.0 / (2.0 + (7.0 - 3.5)))))))))));
+    EXPECT_DOUBLE((a - b) / (b - gd) - a / (b * 2.0 - gd), 5.0 / 0.75 - 7.0 / 2.75);
+    EXPECT_DOUBLE((f - gf) * (f / (gf + 0.25f)), 13.0);
+    EXPECT_INT(a > b * 3.0, 1);
+    EXPECT_INT(f - 1.0f <= gf * 4.0f, 1);
+    EXPECT_INT((_Bool)(zero / zero), 1);
+    EXPECT_INT((_Bool)zero, 0);
+}
+
+void test_fold_float() {
+    float tenth = 0.1f, big = 16777217.0f;
+    EXPECT_INT(0.1f == 0.1, 0);
+    EXPECT_INT(0.1f == tenth, 1);
+    EXPECT_DOUBLE((double)0.1f, (double)tenth);
+    EXPECT_DOUBLE((double)16777217.0f, 16777216.0);
+    EXPECT_DOUBLE((double)16777217.0f, (double)big);
+    EXPECT_INT((int)16777217.0f, 16777216);
+    EXPECT_DOUBLE(0.1f * 3.0, 0.30000000447034836);
+    EXPECT_DOUBLE(0.1f * 3.0, tenth * 3.0);
+    EXPECT_INT((_Bool)1e-50f, 0);
+}
+
 int main() {
     test_float1();
     test_float2();
     test_float3();
+    test_float4();
+    test_fold_float();
     print_result(); 
 }
\ No newline at end of file
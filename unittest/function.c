@@ -92,6 +92,130 @@ void test_multiarg(
     EXPECT_DOUBLE(v40, 40.0);
 }
 
+static inline int clamp(int v, int lo, int hi) {
+    if(v < lo) return lo;
+    if(v > hi) return hi;
+    return v;
+}
+
+static int sum_to(int n) {
+    int s = 0;
+    for(int i = 1; i <= n; i++) s += i;
+    return s;
+}
+
+static void add_to(int* p, int k) {
+    *p += k;
+}
+
+void test_inline() {
+    int a = 7, arr[3] = {0};
+    EXPECT_INT(clamp(a, 0, 5), 5);
+    EXPECT_INT(clamp(-a, 0, 5), 0);
+    EXPECT_INT(clamp(3, 0, 5), 3);
+    EXPECT_INT(sum_to(10) + sum_to(clamp(a, 0, 4)), 65);
+    add_to(&a, 3);
+    EXPECT_INT(a, 10);
+    arr[clamp(a, 0, 2)]++;
+    EXPECT_INT(arr[2], 1);
+}
+
+struct nibbles {
+    unsigned lo:4;
+    unsigned hi:4;
+};
+
+static int pack(int lo, int hi) {
+    struct nibbles n;
+    n.lo = lo;
+    n.hi = hi;
+    return n.hi * 16 + n.lo;
+}
+
+static double twice_n(double x, int n) {
+    while(n-- > 0) x = x * 2;
+    return x;
+}
+
+static long sum_squares(int n) {
+    long a[32];
+    long s;
+    int i;
+    for(i = 0; i < n; i++) a[i] = i * i;
+    for(s = 0, i = 0; i < n; i++) s += a[i];
+    return s;
+}
+
+// called through pointers so that they are not inlined
+void test_leaf() {
+    int (*p)(int, int) = pack;
+    double (*q)(double, int) = twice_n;
+    long (*r)(int) = sum_squares;
+    EXPECT_INT(p(3, 10), 163);
+    EXPECT_INT(p(17, 1), 17);
+    EXPECT_DOUBLE(q(1.5, 3), 12.0);
+    EXPECT_INT(r(32), 10416);
+}
+
+static long sum7(long a, long b, long c, long d, long e, long f, long g) {
+    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7;
+}
+
+static double mix(int a, double b, long c, float d) {
+    return a * b + c * d;
+}
+
+void test_args() {
+    int (*p)(int) = func2;
+    long (*q)(long, long, long, long, long, long, long) = sum7;
+    double (*r)(int, double, long, float) = mix;
+    int k = 3;
+    double x = 0.5;
+    EXPECT_INT(q(1, 1, 1, 1, 1, 1, 1), 28);
+    EXPECT_INT(q(k, p(k), q(0, 0, 0, 0, 0, 0, 1), k, 0, 0, k), 59);
+    EXPECT_DOUBLE(r(k, x, p(1), 2.0f), 3.5);
+    EXPECT_DOUBLE(r(p(k), r(2, x, 1, 0.5f), k, x), 3.0);
+    EXPECT_INT(func2(func2(-k)), -1);
+}
+
+static long count_down(long n, long acc) {
+    if(n == 0) return acc;
+    return count_down(n - 1, acc + 1);
+}
+
+struct frame_buf {
+    int n;
+    char buf[16];
+};
+
+// overwrites the stack below its caller before reading p
+static int clobber_sum(char* p) {
+    char junk[64];
+    for(int i = 0; i < 64; i++) 
+        junk[i] = 99;
+    return p[0] + p[1] + junk[p[1]] - 99;
+}
+
+// calls through pointers are not inlined
+static int (*sum_buf)(char*) = clobber_sum;
+
+// a pointer into the frame is passed, so the call must not replace the frame
+static int pass_member(int a) {
+    struct frame_buf s;
+    s.buf[0] = a;
+    s.buf[1] = 1;
+    return sum_buf(s.buf);
+}
+
+// a tail call when optimizing, and still within the default stack at -O0
+void test_tail_call() {
+    long depth = count_down(100000, 0);
+    EXPECT_INT(depth, 100000);
+    int (*f)(int) = pass_member;
+    int sum = f(42);
+    EXPECT_INT(sum, 43);
+}
+
 void test_vararg(char* s, ...) {
     va_list ap;
     va_start(ap, s);
@@ -106,6 +230,10 @@ void test_vararg(char* s, ...) {
 
 int main() {
     test_func();
+    test_inline();
+    test_leaf();
+    test_args();
+    test_tail_call();
     test_multiarg(
         1.0,  2,  3.0,  4,  5.0,  6,  7.0,  8,  9.0,  10,
         11.0, 12, 13.0, 14, 15.0, 16, 17.0, 18, 19.0, 20,
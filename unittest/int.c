@@ -16,7 +16,30 @@ void test_int() {
     EXPECT_INT('\077', 077);
 }
 
+void test_int_type() {
+    EXPECT_INT(sizeof(2147483647), 4);
+    EXPECT_INT(sizeof(2147483648), 8);
+    EXPECT_INT(sizeof(4294967295u), 4);
+    EXPECT_INT(sizeof(4294967296u), 8);
+    EXPECT_INT(sizeof(5000000000u), 8);
+    EXPECT_INT(5000000000u/3, 1666666666);
+    EXPECT_INT(sizeof(0x7FFFFFFF), 4);
+    EXPECT_INT(sizeof(0xFFFFFFFF), 4);
+    EXPECT_INT(sizeof(0x100000000), 8);
+    EXPECT_INT(sizeof(1l), 8);
+    EXPECT_INT(sizeof(1u), 4);
+    EXPECT_INT(-1 < 0xFFFFFFFF, 0);
+    EXPECT_INT(-1 < 4294967295, 1);
+    EXPECT_INT(-1 < 4294967295u, 0);
+    EXPECT_INT(-1 < 0x7FFFFFFFFFFFFFFF, 1);
+    EXPECT_INT(-1 < 0x8000000000000000, 0);
+    EXPECT_INT(-1 < 017777777777, 1);
+    EXPECT_INT(-1 < 037777777777, 0);
+    EXPECT_INT(-1l < 4294967295ul, 0);
+}
+
 int main() {
     test_int();
+    test_int_type();
     print_result(); 
 }
\ No newline at end of file
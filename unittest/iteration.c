@@ -17,7 +17,73 @@ void test_iteration() {
     EXPECT_INT(i, 50);
 }
 
+// variables of disjoint blocks share stack slots
+void test_block_scope() {
+    int carry = 0, sum = 0, i;
+    for(i = 0; i < 4; i++) {
+        { int a = i * 2; sum += a + carry; }
+        { char c = 1; short s = 2; long l = 3; carry = c + s + l + i; }
+    }
+    EXPECT_INT(sum, 33);
+    EXPECT_INT(carry, 9);
+    {
+        int a[8];
+        for(i = 0; i < 8; i++) a[i] = i;
+        sum = a[7];
+    }
+    {
+        long b[4] = {0};
+        EXPECT_INT(b[3], 0);
+        b[3] = sum;
+        EXPECT_INT(b[3], 7);
+    }
+    sum = 0;
+    for(int j = 0; j < 4; j++) {
+        { int t = j + 10; sum += t; }
+        sum += j;
+    }
+    EXPECT_INT(sum, 52);
+}
+
+static int g_bound = 6;
+
+static int next_bound() { return ++g_bound; }
+
+void test_loop_opt() {
+    int a[5][4], n = 5, m = 4, sum = 0, i, j;
+    for(i = 0; i < n; i++)
+        for(j = 0; j < m; j++)
+            a[i][j] = i * m + j;
+    int* q = a[0];
+    for(i = 0; i < n * m; i += 3) 
+        sum += q[i] + n * m;
+    EXPECT_INT(sum, 203);
+    long b[10];
+    i = 9;
+    while(i >= 0) {
+        b[i] = i * 10;
+        if(i < 9) b[i] += b[i + 1];
+        i--;
+    }
+    EXPECT_INT(b[0], 450);
+    sum = 0;
+    for(i = 0; i < g_bound; i++) {
+        sum += g_bound;
+        if(i == 2) next_bound();
+    }
+    EXPECT_INT(sum, 46);
+    int k = 0, *p = &k;
+    sum = 0;
+    for(i = 0; i < 4; i++) {
+        sum += k * 2;
+        (*p)++;
+    }
+    EXPECT_INT(sum, 12);
+}
+
 int main() {
     test_iteration();
+    test_block_scope();
+    test_loop_opt();
     print_result(); 
 }
\ No newline at end of file
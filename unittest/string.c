@@ -20,7 +20,30 @@ void test_string() {
     EXPECT_INT(str[0], '\0');
 }
 
+#define PIECE "ab"
+#define STR(x) #x
+#define LINE_STR(x) STR(x)
+
+void test_concat() {
+    EXPECT_INT(sizeof("ab" "cd"), 5);
+    EXPECT_INT(sizeof("ab" "" "cd" "e"), 6);
+    char* s = "x" "\0y" "z";
+    EXPECT_INT(s[1], 0);
+    EXPECT_INT(s[2], 'y');
+    EXPECT_INT(s[3], 'z');
+    EXPECT_STRING(PIECE "cd", "abcd");
+    EXPECT_STRING(PIECE, "ab");
+    EXPECT_STRING(u8"ab" "cd", "abcd");
+    EXPECT_STRING("ab" STR(c) "d", "abcd");
+    EXPECT_STRING(STR(hello) " world", "hello world");
+    EXPECT_STRING("a" STR() "b", "ab");
+    EXPECT_INT(sizeof(STR(abc)), 4);
+    EXPECT_INT(sizeof("x" STR() STR(y)), 3);
+    EXPECT_STRING("line " LINE_STR(__LINE__), "line 42");
+}
+
 int main() {
     test_string();
+    test_concat();
     print_result(); 
 }
\ No newline at end of file
@@ -72,7 +72,120 @@ void test_struct() {
     EXPECT_DOUBLE(cmpd.y.b, 2.0);
 }
 
+struct small { char c[3]; };
+struct big { int v[100]; };
+
+int sum_big(struct big b) {
+    return b.v[0] + b.v[50] + b.v[99];
+}
+
+void test_copy() {
+    struct small s1 = {{1, 2, 3}}, s2;
+    char guard = 9;
+    s2 = s1;
+    EXPECT_INT(s2.c[2], 3);
+    EXPECT_INT(guard, 9);
+
+    struct big b1 = {{1, [50] = 2, [99] = 3}}, b2;
+    b2 = b1;
+    EXPECT_INT(b2.v[49], 0);
+    EXPECT_INT(sum_big(b2), 6);
+
+    char buf[1000] = {7};
+    EXPECT_INT(buf[0], 7);
+    EXPECT_INT(buf[999], 0);
+}
+
+struct pair { int x, y; };
+struct outer { struct pair* in; int n; };
+
+int sum_members(struct outer* o) {
+    return o->in->x * o->in->x + o->in->y * o->in->y;
+}
+
+int reload(struct outer* o, int* q) {
+    int r = o->in->x + o->n;
+    *q = 10;
+    return r + o->in->x + o->n;
+}
+
+int restrict_reuse(int* restrict a, int* restrict b) {
+    int r = a[0] * 3;
+    b[0] = 5;
+    return r + a[0] * 3;
+}
+
+struct tagged { char buf[8]; int n; };
+
+void set_tag(char* p) {
+    ((struct tagged*)p)->n = 100;
+}
+
+// s.buf decaying to a pointer gives access to all of s
+int reload_decayed() {
+    struct tagged s;
+    s.n = 5;
+    char* q = s.buf;
+    int x = s.n * 3;
+    ((struct tagged*)q)->n = 7;
+    int y = s.n * 3;
+    return x * 100 + y;
+}
+
+int reload_after_call() {
+    struct tagged t;
+    t.n = 6;
+    int a = t.n * 5;
+    set_tag(t.buf);
+    int b = t.n * 5;
+    return a * 1000 + b;
+}
+
+void test_reuse() {
+    struct pair p = {3, 4};
+    struct outer o = {&p, 1};
+    EXPECT_INT(sum_members(&o), 25);
+    int r = reload(&o, &o.n);
+    EXPECT_INT(r, 17);
+    r = reload(&o, &p.x);
+    EXPECT_INT(r, 33);
+    int a = 2, b = 0;
+    r = restrict_reuse(&a, &b);
+    EXPECT_INT(r, 12);
+    r = reload_decayed();
+    EXPECT_INT(r, 1521);
+    r = reload_after_call();
+    EXPECT_INT(r, 30500);
+}
+
+struct wide {
+    int f0, f1, f2, f3, f4, f5, f6, f7;
+    union {
+        int u;
+        struct {
+            short lo;
+            short hi;
+        };
+    };
+    int f9;
+};
+
+void test_fields() {
+    struct wide w = {.f9 = 9, .f3 = 3, .u = 0x20001};
+    struct wide* p = &w;
+    EXPECT_INT(w.f3, 3);
+    EXPECT_INT(w.f4, 0);
+    EXPECT_INT(p->f9, 9);
+    EXPECT_INT(p->lo, 1);
+    EXPECT_INT(p->hi, 2);
+    p->hi = 5;
+    EXPECT_INT(w.u, 0x50001);
+}
+
 int main() {
     test_struct();
+    test_copy();
+    test_reuse();
+    test_fields();
     print_result(); 
 }
\ No newline at end of file
@@ -7,6 +7,10 @@ do
     then
         mcc -o $target $file
         ./$target
+        mcc -fomit-frame-pointer -o $target $file
+        ./$target
+        mcc -O0 -o $target $file
+        ./$target
         rm $target
     fi
 done    